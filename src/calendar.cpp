@@ -1,12 +1,30 @@
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
 #include <cstdint>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "implot.h"
 
 using namespace std;
@@ -14,6 +32,8 @@ using namespace std;
 int16_t MIN_YEAR = 2000;
 int16_t MAX_YEAR = 2038;
 const char* SAVE_PATH = "calendar.bin";
+const char* JOURNAL_PATH = "calendar.journal";
+const char* OLD_JOURNAL_PATH = "calendar.journal.old";
 
 struct Date {
   int16_t year;
@@ -23,25 +43,22 @@ struct Date {
   auto operator<=>(const Date&) const = default;
 };
 
-struct App {
-  float w, h;
-
-  Date selectedDate;
-  map<Date, vector<string>> meetings;
-
-  bool addMeetingWindowOpen;
-};
-
 int DaysInMonth(int8_t month, int16_t year) {
+  static const int8_t MONTH_LENGTHS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
   assert(month >= 1 && month <= 12);
   if (month == 2) {
     bool isLeapYear = (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0));
     return isLeapYear ? 29 : 28;
   } else {
-    return (month % 2) ? 31 : 30;
+    return MONTH_LENGTHS[month - 1];
   }
 }
 
+const char* DAY_LABELS[32] = {
+  "",   "1",  "2",  "3",  "4",  "5",  "6",  "7",  "8",  "9",  "10", "11", "12", "13", "14", "15",
+  "16", "17", "18", "19", "20", "21", "22", "23", "24", "25", "26", "27", "28", "29", "30", "31",
+};
+
 const char* MonthToShortString(int8_t month) {
   assert(month >= 1 && month <= 12);
   switch (month) {
@@ -73,6 +90,670 @@ Date Today() {
   return today;
 }
 
+// Meeting times are minutes since 1970-01-01 00:00 in calendar (local)
+// time, so a day is always MINUTES_PER_DAY long.
+typedef int64_t Minutes;
+constexpr Minutes MINUTES_PER_DAY = 24*60;
+
+// Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+// days_from_civil).
+int64_t DayNumber(Date date) {
+  int64_t year = date.year - (date.month <= 2);
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t yearOfEra = year - era*400;
+  int64_t dayOfYear = (153*(date.month + (date.month > 2 ? -3 : 9)) + 2)/5 + date.day - 1;
+  int64_t dayOfEra = yearOfEra*365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+  return era*146097 + dayOfEra - 719468;
+}
+
+Minutes DateToMinutes(Date date) {
+  return DayNumber(date)*MINUTES_PER_DAY;
+}
+
+// Inverse of DayNumber (civil_from_days).
+Date DateFromDayNumber(int64_t dayNumber) {
+  dayNumber += 719468;
+  int64_t era = (dayNumber >= 0 ? dayNumber : dayNumber - 146096) / 146097;
+  int64_t dayOfEra = dayNumber - era*146097;
+  int64_t yearOfEra = (dayOfEra - dayOfEra/1460 + dayOfEra/36524 - dayOfEra/146096) / 365;
+  int64_t dayOfYear = dayOfEra - (365*yearOfEra + yearOfEra/4 - yearOfEra/100);
+  int64_t monthIndex = (5*dayOfYear + 2)/153;
+
+  Date date = {};
+  date.day = dayOfYear - (153*monthIndex + 2)/5 + 1;
+  date.month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+  date.year = yearOfEra + era*400 + (date.month <= 2);
+  return date;
+}
+
+// 0 = Monday. 1970-01-01 was a Thursday.
+int Weekday(int64_t dayNumber) {
+  return ((dayNumber + 3) % 7 + 7) % 7;
+}
+
+// A meeting covers [start, end). Records are flat and fixed-size, and
+// titles live in one shared buffer, so a store is a handful of arrays.
+struct MeetingRecord {
+  Minutes start;
+  Minutes end;
+  Minutes maxEnd;  // Largest end in this record's subtree, see IndexMeetings.
+  uint64_t id;
+  uint32_t titleOffset;
+  uint32_t titleSize;
+};
+
+// Records are sorted by start and double as an implicit interval tree
+// (as in Heng Li's cgranges): record i sits at level k = number of
+// trailing one bits of i, its children are i -/+ 2^(k-1), and the root is
+// 2^rootLevel - 1. No pointers, so the arrays can be written out as is.
+//
+// A store holds two such arrays. records and titles point into the mapped
+// snapshot and are never copied; its removed meetings are kept as sorted
+// tombstones in removedIds. Meetings added since live in ownedRecords and
+// ownedTitles. Queries number the snapshot's records first, then the
+// owned ones, see MeetingAt.
+struct MeetingStore {
+  MeetingRecord const* records;
+  size_t count;
+  string_view titles;
+  int rootLevel;
+  shared_ptr<void> mapping;
+  vector<uint64_t> removedIds;
+
+  vector<MeetingRecord> ownedRecords;
+  string ownedTitles;
+  int ownedRootLevel;
+  size_t deadTitleBytes;
+
+  uint64_t nextId;
+  uint64_t version;  // Bumped on every change.
+};
+
+string_view RecordTitle(string_view titles, MeetingRecord const& record) {
+  // Offsets in a mapped snapshot aren't checked up front.
+  if (record.titleOffset > titles.size()) return {};
+  return titles.substr(record.titleOffset, record.titleSize);
+}
+
+MeetingRecord const& MeetingAt(MeetingStore const& store, uint32_t i) {
+  return i < store.count ? store.records[i] : store.ownedRecords[i - store.count];
+}
+
+string_view MeetingTitle(MeetingStore const& store, uint32_t i) {
+  return RecordTitle(i < store.count ? store.titles : string_view(store.ownedTitles), MeetingAt(store, i));
+}
+
+bool MeetingRemoved(MeetingStore const& store, uint64_t id) {
+  return binary_search(store.removedIds.begin(), store.removedIds.end(), id);
+}
+
+bool HasMeetings(MeetingStore const& store) {
+  return !store.ownedRecords.empty() || store.count > store.removedIds.size();
+}
+
+// Fills maxEnd bottom up, level by level, and returns the root level.
+// Nodes past the end of the array are virtual: their maxEnd is that of the
+// last real node below them.
+int IndexRecords(vector<MeetingRecord>& records) {
+  int64_t n = records.size();
+  if (n == 0) return 0;
+
+  int64_t lastIndex = 0;
+  Minutes last = 0;
+  for (int64_t i = 0; i < n; i += 2) {
+    lastIndex = i;
+    last = records[i].maxEnd = records[i].end;
+  }
+  int level = 1;
+  for (; (int64_t(1) << level) <= n; ++level) {
+    int64_t half = int64_t(1) << (level - 1);
+    for (int64_t i = 2*half - 1; i < n; i += 4*half) {
+      Minutes left = records[i - half].maxEnd;
+      Minutes right = i + half < n ? records[i + half].maxEnd : last;
+      records[i].maxEnd = max({ records[i].end, left, right });
+    }
+    lastIndex = (lastIndex >> level & 1) ? lastIndex - half : lastIndex + half;
+    if (lastIndex < n) last = max(last, records[lastIndex].maxEnd);
+  }
+  return level - 1;
+}
+
+void IndexMeetings(MeetingStore& store) {
+  store.ownedRootLevel = IndexRecords(store.ownedRecords);
+  ++store.version;
+}
+
+bool MeetingBefore(MeetingRecord const& a, MeetingRecord const& b) {
+  return a.start != b.start ? a.start < b.start : a.id < b.id;
+}
+
+// Adds without reindexing, for loading many at once; SortMeetings after.
+// A zero id picks the next free one.
+uint64_t AppendMeeting(MeetingStore& store, Minutes start, Minutes end, string_view title, uint64_t id = 0) {
+  MeetingRecord record = {};
+  record.start = start;
+  record.end = max(end, start + 1);
+  record.id = id ? id : store.nextId + 1;
+  store.nextId = max(store.nextId, record.id);
+
+  record.titleOffset = store.ownedTitles.size();
+  record.titleSize = title.size();
+  store.ownedTitles += title;
+  store.ownedRecords.push_back(record);
+  return record.id;
+}
+
+void SortMeetings(MeetingStore& store) {
+  sort(store.ownedRecords.begin(), store.ownedRecords.end(), MeetingBefore);
+  IndexMeetings(store);
+}
+
+uint64_t AddMeeting(MeetingStore& store, Minutes start, Minutes end, string_view title, uint64_t id = 0) {
+  id = AppendMeeting(store, start, end, title, id);
+  vector<MeetingRecord>& records = store.ownedRecords;
+  MeetingRecord record = records.back();
+  records.pop_back();
+  records.insert(upper_bound(records.begin(), records.end(), record, MeetingBefore), record);
+  IndexMeetings(store);
+  return id;
+}
+
+// Adds the records appended since firstNew to the sorted owned ones before
+// it, in time linear in their number.
+void MergeMeetings(MeetingStore& store, size_t firstNew) {
+  vector<MeetingRecord>& records = store.ownedRecords;
+  sort(records.begin() + firstNew, records.end(), MeetingBefore);
+  inplace_merge(records.begin(), records.begin() + firstNew, records.end(), MeetingBefore);
+  IndexMeetings(store);
+}
+
+// Title bytes of removed meetings are reclaimed once they make up half of
+// the buffer.
+void CompactTitles(MeetingStore& store) {
+  string titles;
+  titles.reserve(store.ownedTitles.size() - store.deadTitleBytes);
+  for (auto& record : store.ownedRecords) {
+    string_view title = RecordTitle(store.ownedTitles, record);
+    record.titleOffset = titles.size();
+    titles += title;
+  }
+  store.ownedTitles = std::move(titles);
+  store.deadTitleBytes = 0;
+}
+
+// An owned meeting is erased; one in the snapshot gets a tombstone.
+bool RemoveMeeting(MeetingStore& store, uint64_t id) {
+  auto match = [id](MeetingRecord const& r) { return r.id == id; };
+  vector<MeetingRecord>& records = store.ownedRecords;
+  auto it = find_if(records.begin(), records.end(), match);
+  if (it != records.end()) {
+    store.deadTitleBytes += it->titleSize;
+    records.erase(it);
+    if (2*store.deadTitleBytes > store.ownedTitles.size()) CompactTitles(store);
+    IndexMeetings(store);
+    return true;
+  }
+
+  auto removed = lower_bound(store.removedIds.begin(), store.removedIds.end(), id);
+  if (removed != store.removedIds.end() && *removed == id) return false;
+  if (find_if(store.records, store.records + store.count, match) == store.records + store.count) return false;
+  store.removedIds.insert(removed, id);
+  ++store.version;
+  return true;
+}
+
+// Removes many at once; ids must be sorted. Those not among the owned
+// meetings become tombstones without a look through the snapshot.
+void RemoveMeetings(MeetingStore& store, vector<uint64_t> const& ids) {
+  if (ids.empty()) return;
+
+  vector<uint64_t> erased;
+  erase_if(store.ownedRecords, [&](MeetingRecord const& record) {
+    if (!binary_search(ids.begin(), ids.end(), record.id)) return false;
+    store.deadTitleBytes += record.titleSize;
+    erased.push_back(record.id);
+    return true;
+  });
+  sort(erased.begin(), erased.end());
+  size_t firstNew = store.removedIds.size();
+  set_difference(ids.begin(), ids.end(), erased.begin(), erased.end(), back_inserter(store.removedIds));
+  inplace_merge(store.removedIds.begin(), store.removedIds.begin() + firstNew, store.removedIds.end());
+  store.removedIds.erase(unique(store.removedIds.begin(), store.removedIds.end()), store.removedIds.end());
+
+  if (2*store.deadTitleBytes > store.ownedTitles.size()) CompactTitles(store);
+  IndexMeetings(store);
+}
+
+// Appends to out firstIndex plus the indices of the records overlapping
+// [begin, end), in start order. Descends only into subtrees whose maxEnd
+// reaches begin, and scans small subtrees (k <= 3) linearly.
+void QueryRecords(MeetingRecord const* records, int64_t n, int rootLevel, uint32_t firstIndex, Minutes begin, Minutes end, vector<uint32_t>& out) {
+  struct Frame {
+    int64_t index;
+    int level;
+    bool leftDone;
+  };
+
+  if (n == 0) return;
+
+  Frame stack[64];
+  int top = 0;
+  stack[top++] = { (int64_t(1) << rootLevel) - 1, rootLevel, false };
+  while (top > 0) {
+    Frame frame = stack[--top];
+    if (frame.level <= 3) {
+      int64_t first = frame.index >> frame.level << frame.level;
+      int64_t last = min(n, first + (int64_t(1) << (frame.level + 1)) - 1);
+      for (int64_t i = first; i < last && records[i].start < end; ++i) {
+        if (begin < records[i].end) out.push_back(firstIndex + (uint32_t)i);
+      }
+    } else if (!frame.leftDone) {
+      int64_t left = frame.index - (int64_t(1) << (frame.level - 1));
+      stack[top++] = { frame.index, frame.level, true };
+      if (left >= n || records[left].maxEnd > begin) stack[top++] = { left, frame.level - 1, false };
+    } else if (frame.index < n && records[frame.index].start < end) {
+      if (begin < records[frame.index].end) out.push_back(firstIndex + (uint32_t)frame.index);
+      stack[top++] = { frame.index + (int64_t(1) << (frame.level - 1)), frame.level - 1, false };
+    }
+  }
+}
+
+// Appends to out the indices of the meetings overlapping [begin, end), in
+// start order: the snapshot's without its tombstones merged with the owned
+// ones.
+void QueryMeetings(MeetingStore const& store, Minutes begin, Minutes end, vector<uint32_t>& out) {
+  size_t first = out.size();
+  QueryRecords(store.records, store.count, store.rootLevel, 0, begin, end, out);
+  if (!store.removedIds.empty()) {
+    auto removed = [&](uint32_t i) { return MeetingRemoved(store, store.records[i].id); };
+    out.erase(remove_if(out.begin() + first, out.end(), removed), out.end());
+  }
+
+  size_t middle = out.size();
+  QueryRecords(store.ownedRecords.data(), store.ownedRecords.size(), store.ownedRootLevel, store.count, begin, end, out);
+  inplace_merge(out.begin() + first, out.begin() + middle, out.end(), [&](uint32_t a, uint32_t b) {
+    return MeetingBefore(MeetingAt(store, a), MeetingAt(store, b));
+  });
+}
+
+// RRULE-like recurrence: FREQ, INTERVAL, BYDAY (weekly only) and UNTIL,
+// plus EXDATE exceptions. Only the rule is stored; occurrences are
+// generated for the months on screen and cached per month.
+enum RecurrenceFrequency : uint8_t {
+  Recur_Daily,
+  Recur_Weekly,
+  Recur_Monthly,
+  Recur_Count,
+};
+
+const char* RECURRENCE_NAMES[Recur_Count] = { "Daily", "Weekly", "Monthly" };
+const char* WEEKDAY_NAMES[7] = { "Mo", "Tu", "We", "Th", "Fr", "Sa", "Su" };
+const char* WEEKDAY_NAMES_UPPER[7] = { "MO", "TU", "WE", "TH", "FR", "SA", "SU" };
+
+struct RecurrenceRule {
+  uint64_t id;
+  RecurrenceFrequency frequency;
+  int32_t interval;            // Every interval days, weeks or months.
+  uint8_t weekdays;            // Weekly: bit d for weekday d, 0 = Monday.
+  int64_t firstDay, lastDay;   // Day numbers, inclusive.
+  Minutes startTime;           // Into the day.
+  Minutes duration;
+  string title;
+  vector<int64_t> exceptions;  // Sorted day numbers to skip.
+};
+
+struct Occurrence {
+  Minutes start;
+  Minutes end;
+  uint64_t ruleId;
+};
+
+struct Recurrences {
+  vector<RecurrenceRule> rules;
+  uint64_t nextId;
+  uint64_t version;  // Bumped on every rule change.
+  Minutes longestDuration;
+
+  // Occurrences starting in a month, by start, keyed by MonthIndex. Months
+  // are expanded when first looked at and dropped when a rule covering
+  // them changes.
+  map<int32_t, vector<Occurrence>> months;
+};
+
+int32_t MonthIndex(Date date) {
+  return date.year*12 + date.month - 1;
+}
+
+Date MonthStart(int32_t month) {
+  return { (int16_t)(month / 12), (int8_t)(month % 12 + 1), 1 };
+}
+
+void ExpandRule(RecurrenceRule const& rule, int64_t fromDay, int64_t toDay, vector<Occurrence>& out) {
+  fromDay = max(fromDay, rule.firstDay);
+  toDay = min(toDay, rule.lastDay + 1);
+  if (fromDay >= toDay) return;
+
+  auto emit = [&](int64_t day) {
+    if (binary_search(rule.exceptions.begin(), rule.exceptions.end(), day)) return;
+    Minutes start = day*MINUTES_PER_DAY + rule.startTime;
+    out.push_back({ start, start + rule.duration, rule.id });
+  };
+
+  switch (rule.frequency) {
+    case Recur_Daily: {
+      int64_t skip = (fromDay - rule.firstDay + rule.interval - 1) / rule.interval;
+      for (int64_t day = rule.firstDay + skip*rule.interval; day < toDay; day += rule.interval) {
+        emit(day);
+      }
+    } break;
+    case Recur_Weekly: {
+      int64_t firstWeek = rule.firstDay - Weekday(rule.firstDay);
+      int64_t period = 7*rule.interval;
+      for (int64_t week = firstWeek + (fromDay - firstWeek) / period * period; week < toDay; week += period) {
+        for (int weekday = 0; weekday < 7; ++weekday) {
+          int64_t day = week + weekday;
+          if ((rule.weekdays >> weekday & 1) && fromDay <= day && day < toDay) emit(day);
+        }
+      }
+    } break;
+    case Recur_Monthly: {
+      // Months too short for the day are skipped, as RRULE does.
+      Date first = DateFromDayNumber(rule.firstDay);
+      int32_t firstMonth = MonthIndex(first);
+      int32_t skip = (MonthIndex(DateFromDayNumber(fromDay)) - firstMonth) / rule.interval;
+      for (int32_t month = firstMonth + skip*rule.interval; ; month += rule.interval) {
+        int64_t monthStart = DayNumber(MonthStart(month));
+        if (monthStart >= toDay) break;
+        int64_t day = monthStart + first.day - 1;
+        if (day >= DayNumber(MonthStart(month + 1))) continue;
+        if (fromDay <= day && day < toDay) emit(day);
+      }
+    } break;
+    default: break;
+  }
+}
+
+vector<Occurrence> const& MonthOccurrences(Recurrences& recurrences, int32_t month) {
+  auto [it, inserted] = recurrences.months.try_emplace(month);
+  if (inserted) {
+    int64_t fromDay = DayNumber(MonthStart(month));
+    int64_t toDay = DayNumber(MonthStart(month + 1));
+    for (RecurrenceRule const& rule : recurrences.rules) {
+      ExpandRule(rule, fromDay, toDay, it->second);
+    }
+    sort(it->second.begin(), it->second.end(), [](Occurrence const& a, Occurrence const& b) { return a.start < b.start; });
+  }
+  return it->second;
+}
+
+// Appends the occurrences overlapping [begin, end). Earlier months are
+// looked at as far back as the longest rule lasts.
+void QueryOccurrences(Recurrences& recurrences, Minutes begin, Minutes end, vector<Occurrence>& out) {
+  if (recurrences.rules.empty() || begin >= end) return;
+
+  int32_t first = MonthIndex(DateFromDayNumber((begin - recurrences.longestDuration) / MINUTES_PER_DAY));
+  int32_t last = MonthIndex(DateFromDayNumber((end - 1) / MINUTES_PER_DAY));
+  for (int32_t month = first; month <= last; ++month) {
+    for (Occurrence const& occurrence : MonthOccurrences(recurrences, month)) {
+      if (occurrence.start >= end) break;
+      if (begin < occurrence.end) out.push_back(occurrence);
+    }
+  }
+}
+
+void InvalidateRule(Recurrences& recurrences, RecurrenceRule const& rule) {
+  auto first = recurrences.months.lower_bound(MonthIndex(DateFromDayNumber(rule.firstDay)));
+  auto last = recurrences.months.upper_bound(MonthIndex(DateFromDayNumber(rule.lastDay)));
+  recurrences.months.erase(first, last);
+  ++recurrences.version;
+}
+
+RecurrenceRule* FindRule(Recurrences& recurrences, uint64_t id) {
+  for (RecurrenceRule& rule : recurrences.rules) {
+    if (rule.id == id) return &rule;
+  }
+  return nullptr;
+}
+
+// A zero rule.id picks the next free one.
+uint64_t AddRecurrence(Recurrences& recurrences, RecurrenceRule rule) {
+  if (!rule.id) rule.id = recurrences.nextId + 1;
+  recurrences.nextId = max(recurrences.nextId, rule.id);
+  rule.interval = max(rule.interval, 1);
+  rule.duration = max<Minutes>(rule.duration, 1);
+  if (rule.frequency == Recur_Weekly && rule.weekdays == 0) rule.weekdays = 1 << Weekday(rule.firstDay);
+  sort(rule.exceptions.begin(), rule.exceptions.end());
+  recurrences.longestDuration = max(recurrences.longestDuration, rule.duration);
+
+  InvalidateRule(recurrences, rule);
+  recurrences.rules.push_back(std::move(rule));
+  return recurrences.rules.back().id;
+}
+
+bool RemoveRecurrence(Recurrences& recurrences, uint64_t id) {
+  RecurrenceRule* rule = FindRule(recurrences, id);
+  if (!rule) return false;
+
+  InvalidateRule(recurrences, *rule);
+  recurrences.rules.erase(recurrences.rules.begin() + (rule - recurrences.rules.data()));
+  return true;
+}
+
+// Skips the occurrence of the rule on day.
+bool AddRecurrenceException(Recurrences& recurrences, uint64_t id, int64_t day) {
+  RecurrenceRule* rule = FindRule(recurrences, id);
+  if (!rule) return false;
+
+  auto it = lower_bound(rule->exceptions.begin(), rule->exceptions.end(), day);
+  if (it == rule->exceptions.end() || *it != day) rule->exceptions.insert(it, day);
+  InvalidateRule(recurrences, *rule);
+  return true;
+}
+
+// Bit d is set when day d of year has a meeting or an occurrence. Rebuilt
+// with a single query over the year whenever the year, the store or the
+// rules change, so drawing a day cell is one bit test.
+struct DayBitmap {
+  int16_t year;
+  uint64_t version;
+  uint64_t recurrenceVersion;
+  uint64_t bits[6];
+  vector<uint32_t> scratch;
+  vector<Occurrence> occurrences;
+};
+
+void MarkDays(DayBitmap& bitmap, int64_t firstDay, int64_t dayCount, Minutes start, Minutes end) {
+  int64_t from = max<int64_t>(0, start / MINUTES_PER_DAY - firstDay);
+  int64_t to = min<int64_t>(dayCount - 1, (end - 1) / MINUTES_PER_DAY - firstDay);
+  for (int64_t day = from; day <= to; ++day) bitmap.bits[day / 64] |= uint64_t(1) << (day % 64);
+}
+
+void UpdateDayBitmap(DayBitmap& bitmap, MeetingStore const& store, Recurrences& recurrences, int16_t year) {
+  if (bitmap.year == year && bitmap.version == store.version && bitmap.recurrenceVersion == recurrences.version) return;
+  bitmap.year = year;
+  bitmap.version = store.version;
+  bitmap.recurrenceVersion = recurrences.version;
+  memset(bitmap.bits, 0, sizeof(bitmap.bits));
+
+  int64_t firstDay = DayNumber({ year, 1, 1 });
+  int64_t dayCount = DayNumber({ (int16_t)(year + 1), 1, 1 }) - firstDay;
+  Minutes begin = firstDay*MINUTES_PER_DAY;
+  Minutes end = (firstDay + dayCount)*MINUTES_PER_DAY;
+
+  bitmap.scratch.clear();
+  QueryMeetings(store, begin, end, bitmap.scratch);
+  for (uint32_t i : bitmap.scratch) {
+    MeetingRecord const& record = MeetingAt(store, i);
+    MarkDays(bitmap, firstDay, dayCount, record.start, record.end);
+  }
+
+  bitmap.occurrences.clear();
+  QueryOccurrences(recurrences, begin, end, bitmap.occurrences);
+  for (Occurrence const& occurrence : bitmap.occurrences) {
+    MarkDays(bitmap, firstDay, dayCount, occurrence.start, occurrence.end);
+  }
+}
+
+bool DayHasMeetings(DayBitmap const& bitmap, int dayOfYear) {
+  return bitmap.bits[dayOfYear / 64] >> (dayOfYear % 64) & 1;
+}
+
+// Layout of the selected year, rebuilt only when the year changes, so
+// drawing it computes no dates.
+struct YearGrid {
+  int16_t year;
+  char yearLabel[8];
+  int8_t monthLengths[12];
+  int8_t firstWeekdays[12];     // Of each month's 1st, 0 = Monday.
+  int16_t firstDaysOfYear[12];  // Of each month's 1st, counting from 0.
+};
+
+void UpdateYearGrid(YearGrid& grid, int16_t year) {
+  if (grid.year == year) return;
+  grid.year = year;
+  snprintf(grid.yearLabel, sizeof(grid.yearLabel), "%d", year);
+
+  int64_t firstDay = DayNumber({ year, 1, 1 });
+  for (int8_t month = 1; month <= 12; ++month) {
+    int64_t monthDay = DayNumber({ year, month, 1 });
+    grid.monthLengths[month - 1] = DaysInMonth(month, year);
+    grid.firstWeekdays[month - 1] = Weekday(monthDay);
+    grid.firstDaysOfYear[month - 1] = monthDay - firstDay;
+  }
+}
+
+// The saved calendar is a snapshot (SAVE_PATH) plus an append-only journal
+// of the edits made since (JOURNAL_PATH), so an edit costs one small write
+// whatever the size of the calendar.
+//
+// Each journal record is its payload size and FNV-1a checksum (4 bytes
+// each), then the payload: a sequence number, a JournalOp and its fields.
+// A torn record at the end, left by a crash, fails its checksum and is cut
+// off on load.
+//
+// A snapshot is a SnapshotHeader followed by 8-byte aligned sections:
+// the meeting records exactly as kept in memory, sorted and indexed, so
+// the file is its own date index; the titles they point into; and the
+// recurrence rules, encoded as in the journal. Loading maps the file and
+// checks the header, and queries run on the mapping.
+//
+// Once the journal is long it is renamed to OLD_JOURNAL_PATH, new edits go
+// to a fresh one, and a worker writes a new snapshot and deletes the old
+// journal. A snapshot stores the last sequence number it includes, and
+// records up to it are skipped on replay, so a crash at any step loads
+// the same calendar.
+enum JournalOp : int64_t {
+  Journal_AddMeeting = 1,     // id, start, end, title
+  Journal_RemoveMeeting,      // id
+  Journal_AddRule,            // RecurrenceRule
+  Journal_RemoveRule,         // id
+  Journal_AddException,       // rule id, day
+};
+
+const char SNAPSHOT_MAGIC[8] = { 'C', 'A', 'L', 'E', 'N', 'D', 'A', 'R' };
+const uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t fileSize;
+  uint64_t sequence;  // Of the last journal record included.
+  uint64_t nextMeetingId;
+  uint64_t nextRuleId;
+  uint64_t meetingCount;
+  uint64_t meetingsOffset;
+  uint64_t titlesOffset;
+  uint64_t titlesSize;
+  uint64_t rulesCount;
+  uint64_t rulesOffset;
+  uint64_t rulesSize;
+};
+
+const int64_t COMPACT_JOURNAL_RECORDS = 1024;
+
+struct Compaction {
+  MeetingStore meetings;
+  vector<RecurrenceRule> rules;
+  uint64_t nextRuleId;
+  uint64_t sequence;
+
+  bool ok;  // Set by the worker before done.
+  char status[256];
+  atomic<bool> done;
+
+  jthread worker;
+};
+
+struct Journal {
+  int fd;
+  off_t size;
+  uint64_t sequence;  // Of the last record written or replayed.
+  int64_t records;    // In JOURNAL_PATH.
+  string buffer;      // Records not yet committed.
+  size_t recordStart;
+  int64_t pending;
+  unique_ptr<Compaction> compaction;
+};
+
+// .ics import runs on a worker that reads the file in chunks, unfolds and
+// parses lines as they arrive, and hands events over in batches of
+// ICS_BATCH_SIZE. The UI thread merges each batch into the store and
+// journals it with a single write.
+const size_t ICS_BATCH_SIZE = 16384;
+
+// A day to skip on a rule handed over in an earlier batch, which is
+// known by its position among the import's rules.
+struct IcsException {
+  uint64_t rule;
+  int64_t day;
+};
+
+struct IcsBatch {
+  vector<MeetingRecord> meetings;  // Titles point into titles, ids unset.
+  string titles;
+  vector<RecurrenceRule> rules;
+  vector<IcsException> exceptions;
+};
+
+struct IcsImport {
+  string path;
+  atomic<uint64_t> totalBytes;
+  atomic<uint64_t> bytesRead;
+  atomic<uint64_t> events;
+
+  mutex lock;
+  vector<IcsBatch> batches;  // guarded by lock
+  vector<uint64_t> ruleIds;  // Of the rules applied so far, UI thread only.
+
+  char status[256];  // Set by the worker before done.
+  atomic<bool> done;
+
+  jthread worker;
+};
+
+struct App {
+  float w, h;
+
+  Date selectedDate;
+  Date today;
+  double todayRefreshTime;
+  YearGrid grid;
+  MeetingStore meetings;
+  Recurrences recurrences;
+  DayBitmap meetingDays;
+  vector<uint32_t> dayMeetings;
+  vector<Occurrence> dayOccurrences;
+
+  Journal journal;
+  char status[256];
+
+  unique_ptr<IcsImport> import;
+  char icsPath[256];
+
+  bool addMeetingWindowOpen;
+};
+
 int fsize(FILE* f) {
   if (fseek(f, 0, SEEK_END) == -1) {
     return -1;
@@ -84,7 +765,7 @@ int fsize(FILE* f) {
 }
 
 struct Reader {
-  char* bytes;
+  const char* bytes;
   ssize_t size;
   const char* error;
 };
@@ -94,7 +775,7 @@ int64_t Read_int64_t(Reader &r) {
   if (r.error) return out;
 
   if (r.bytes && sizeof(int64_t) <= r.size) {
-    out = *(int64_t*)(r.bytes);
+    memcpy(&out, r.bytes, sizeof(out));
     r.bytes += sizeof(int64_t);
     r.size -= sizeof(int64_t);
   } else {
@@ -109,7 +790,7 @@ Date Read_Date(Reader &r) {
   if (r.error) return out;
 
   if (r.bytes && sizeof(Date) <= r.size) {
-    out = *(Date*)(r.bytes);
+    memcpy(&out, r.bytes, sizeof(out));
     r.bytes += sizeof(Date);
     r.size -= sizeof(Date);
   } else {
@@ -124,7 +805,7 @@ string Read_string(Reader &r) {
   if (r.error) return out;
 
   int64_t stringSize = Read_int64_t(r);
-  if (r.bytes && stringSize <= r.size) {
+  if (r.bytes && 0 <= stringSize && stringSize <= r.size) {
     out = string(r.bytes, stringSize);
     r.bytes += stringSize;
     r.size -= stringSize;
@@ -135,78 +816,1248 @@ string Read_string(Reader &r) {
   return out;
 }
 
-void SerializeMeetings(App &app) {
-  FILE* f = fopen(SAVE_PATH, "w");
+RecurrenceRule Read_RecurrenceRule(Reader &r) {
+  RecurrenceRule rule = {};
+  rule.id = Read_int64_t(r);
+  rule.frequency = (RecurrenceFrequency)Read_int64_t(r);
+  rule.interval = Read_int64_t(r);
+  rule.weekdays = Read_int64_t(r);
+  rule.firstDay = Read_int64_t(r);
+  rule.lastDay = Read_int64_t(r);
+  rule.startTime = Read_int64_t(r);
+  rule.duration = Read_int64_t(r);
+  rule.title = Read_string(r);
+
+  int64_t exceptionsCount = Read_int64_t(r);
+  for (int64_t i = 0; i < exceptionsCount && !r.error; ++i) {
+    rule.exceptions.push_back(Read_int64_t(r));
+  }
+  if (!r.error && rule.frequency >= Recur_Count) {
+    r.error = "Read_RecurrenceRule: bad frequency";
+  }
+
+  return rule;
+}
+
+void Write_int64_t(string& out, int64_t value) {
+  out.append((const char*)&value, sizeof(value));
+}
+
+void Write_string(string& out, string_view value) {
+  Write_int64_t(out, value.size());
+  out += value;
+}
+
+void Write_RecurrenceRule(string& out, RecurrenceRule const& rule) {
+  int64_t fields[] = { (int64_t)rule.id, rule.frequency, rule.interval, rule.weekdays, rule.firstDay, rule.lastDay, rule.startTime, rule.duration };
+  for (int64_t field : fields) Write_int64_t(out, field);
+  Write_string(out, rule.title);
+  Write_int64_t(out, rule.exceptions.size());
+  for (int64_t day : rule.exceptions) Write_int64_t(out, day);
+}
+
+struct MappedFile {
+  const char* data;
+  size_t size;
+};
 
-  int64_t dateCount = app.meetings.size();
-  assert(fwrite(&dateCount, 1, sizeof(dateCount), f) == sizeof(dateCount));
-  for (auto const& [meetingDate, meetings] : app.meetings) {
-    assert(fwrite(&meetingDate, 1, sizeof(meetingDate), f) == sizeof(meetingDate));
+bool MapFile(const char* path, MappedFile& file, char* error, size_t errorSize) {
+  file = {};
 
-    int64_t meetingsCount = meetings.size();
-    assert(fwrite(&meetingsCount, 1, sizeof(meetingsCount), f) == sizeof(meetingsCount));
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    snprintf(error, errorSize, "open %s: %s", path, strerror(errno));
+    return false;
+  }
 
-    for (string const& meeting : meetings) {
-      int64_t meetingNameCount = meeting.size();
-      assert(fwrite(&meetingNameCount, 1, sizeof(meetingNameCount), f) == sizeof(meetingNameCount));
-      assert(fwrite(meeting.data(), 1, meetingNameCount, f) == meetingNameCount);
+  struct stat st = {};
+  if (fstat(fd, &st) == -1) {
+    snprintf(error, errorSize, "fstat %s: %s", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  file.size = st.st_size;
+  if (file.size > 0) {
+    void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      snprintf(error, errorSize, "mmap %s: %s", path, strerror(errno));
+      close(fd);
+      return false;
     }
+    file.data = (const char*)data;
   }
 
-  fclose(f);
+  close(fd);
+  return true;
 }
 
-map<Date, vector<string>> DeserializeMeetings() {
-  map<Date, vector<string>> newMeetings = {};
+shared_ptr<void> MappingOwner(MappedFile file) {
+  return shared_ptr<void>((void*)file.data, [file](void*) {
+    if (file.data) munmap((void*)file.data, file.size);
+  });
+}
 
-  FILE* f = fopen(SAVE_PATH, "r");
+// Missing files read as empty.
+bool ReadFile(const char* path, string& out, char* status, size_t statusSize) {
+  out.clear();
+  FILE* f = fopen(path, "r");
   if (!f) {
-    perror("fopen: ");
-    return newMeetings;
+    if (errno == ENOENT) return true;
+    snprintf(status, statusSize, "fopen %s: %s", path, strerror(errno));
+    return false;
   }
+
   ssize_t size = fsize(f);
-  if (size != -1) {
-    char* buffer = (char*)calloc(size, sizeof(char));
-    if (fread(buffer, sizeof(*buffer), size, f) == size) {
-      Reader r = {};
-      r.bytes = buffer;
-      r.size = size;
-
-      int64_t dateCount = Read_int64_t(r);
-      for (int64_t i = 0; i < dateCount && !r.error; ++i) {
-        Date d = Read_Date(r);
-        size_t meetingsCount = Read_int64_t(r);
-        for (int64_t j = 0; j < meetingsCount && !r.error; ++j) {
-          string meeting = Read_string(r);
-          if (!r.error) {
-            newMeetings[d].push_back(std::move(meeting));
-          }
+  bool ok = size != -1;
+  if (ok) {
+    out.resize(size);
+    ok = fread(out.data(), 1, size, f) == (size_t)size;
+  }
+  if (!ok) {
+    snprintf(status, statusSize, "read %s: %s", path, strerror(errno));
+  }
+
+  fclose(f);
+  return ok;
+}
+
+bool WriteAll(int fd, const char* bytes, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, bytes, size);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) return false;
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Saves go to a temporary file next to the destination that is renamed over
+// it once complete, so a failed or interrupted save never leaves a
+// truncated file behind.
+int CreateTempFile(const char* path, string& tempPath, char* status, size_t statusSize) {
+  tempPath = string(path) + ".XXXXXX";
+  int fd = mkstemp(tempPath.data());
+  if (fd == -1) {
+    snprintf(status, statusSize, "mkstemp %s: %s", tempPath.c_str(), strerror(errno));
+    return -1;
+  }
+  fchmod(fd, 0644);
+  return fd;
+}
+
+// A rename is only durable once the directory holding it is synced, so this
+// runs before anything that relies on the new name, such as dropping the
+// journals a snapshot replaces.
+bool SyncParentDirectory(const char* path, char* status, size_t statusSize) {
+  const char* slash = strrchr(path, '/');
+  string dir = slash ? string(path, max<size_t>(slash - path, 1)) : string(".");
+  int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd == -1 || fsync(fd) == -1) {
+    snprintf(status, statusSize, "fsync %s: %s", dir.c_str(), strerror(errno));
+    if (fd != -1) close(fd);
+    return false;
+  }
+  close(fd);
+  return true;
+}
+
+bool CommitTempFile(int fd, string const& tempPath, const char* path, bool ok, char* status, size_t statusSize) {
+  if (!ok || fsync(fd) == -1) {
+    snprintf(status, statusSize, "write %s: %s", tempPath.c_str(), strerror(errno));
+    close(fd);
+    unlink(tempPath.c_str());
+    return false;
+  }
+  close(fd);
+
+  if (rename(tempPath.c_str(), path) == -1) {
+    snprintf(status, statusSize, "rename %s: %s", path, strerror(errno));
+    unlink(tempPath.c_str());
+    return false;
+  }
+  return SyncParentDirectory(path, status, statusSize);
+}
+
+bool WriteFileAtomically(const char* path, string const& bytes, char* status, size_t statusSize) {
+  string tempPath;
+  int fd = CreateTempFile(path, tempPath, status, statusSize);
+  if (fd == -1) return false;
+
+  bool ok = WriteAll(fd, bytes.data(), bytes.size());
+  return CommitTempFile(fd, tempPath, path, ok, status, statusSize);
+}
+
+uint32_t Checksum(const char* bytes, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ (uint8_t)bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void AlignTo8(string& out) {
+  out.resize((out.size() + 7) & ~size_t(7));
+}
+
+void EncodeSnapshot(string& out, MeetingStore const& meetings, vector<RecurrenceRule> const& rules, uint64_t nextRuleId, uint64_t sequence) {
+  SnapshotHeader header = {};
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.sequence = sequence;
+  header.nextMeetingId = meetings.nextId;
+  header.nextRuleId = nextRuleId;
+  out.assign(sizeof(header), '\0');
+
+  // The snapshot's live records and the owned ones are merged into one
+  // array and indexed again. Titles are written in record order, so
+  // removed meetings leave no gaps.
+  vector<MeetingRecord> records;
+  records.reserve(meetings.count + meetings.ownedRecords.size());
+  string titles;
+  auto append = [&](MeetingRecord record, string_view title) {
+    record.titleOffset = titles.size();
+    titles += title;
+    records.push_back(record);
+  };
+  size_t owned = 0;
+  for (size_t i = 0; i < meetings.count; ++i) {
+    MeetingRecord const& record = meetings.records[i];
+    if (MeetingRemoved(meetings, record.id)) continue;
+    for (; owned < meetings.ownedRecords.size() && MeetingBefore(meetings.ownedRecords[owned], record); ++owned) {
+      append(meetings.ownedRecords[owned], RecordTitle(meetings.ownedTitles, meetings.ownedRecords[owned]));
+    }
+    append(record, RecordTitle(meetings.titles, record));
+  }
+  for (; owned < meetings.ownedRecords.size(); ++owned) {
+    append(meetings.ownedRecords[owned], RecordTitle(meetings.ownedTitles, meetings.ownedRecords[owned]));
+  }
+  IndexRecords(records);
+
+  header.meetingCount = records.size();
+  header.meetingsOffset = out.size();
+  out.append((const char*)records.data(), records.size()*sizeof(MeetingRecord));
+  header.titlesOffset = out.size();
+  out += titles;
+  header.titlesSize = titles.size();
+  AlignTo8(out);
+
+  header.rulesCount = rules.size();
+  header.rulesOffset = out.size();
+  for (RecurrenceRule const& rule : rules) {
+    Write_RecurrenceRule(out, rule);
+  }
+  header.rulesSize = out.size() - header.rulesOffset;
+
+  header.fileSize = out.size();
+  memcpy(out.data(), &header, sizeof(header));
+}
+
+// Calendars from before snapshots start with MEETINGS_FORMAT_TAG, then
+// hold timed meetings and recurrence rules without ids. Older ones start
+// with a date count and hold, per date, its meetings' names; they load as
+// all-day meetings.
+const int64_t MEETINGS_FORMAT_TAG = -1;
+
+void DecodeLegacyMeetings(Reader &r, MeetingStore& meetings, Recurrences& recurrences) {
+  int64_t tag = Read_int64_t(r);
+  if (tag == MEETINGS_FORMAT_TAG) {
+    int64_t meetingsCount = Read_int64_t(r);
+    for (int64_t i = 0; i < meetingsCount && !r.error; ++i) {
+      Minutes start = Read_int64_t(r);
+      Minutes end = Read_int64_t(r);
+      string meeting = Read_string(r);
+      if (!r.error) {
+        AppendMeeting(meetings, start, end, meeting);
+      }
+    }
+
+    int64_t rulesCount = Read_int64_t(r);
+    for (int64_t i = 0; i < rulesCount && !r.error; ++i) {
+      RecurrenceRule rule = {};
+      rule.frequency = (RecurrenceFrequency)Read_int64_t(r);
+      rule.interval = Read_int64_t(r);
+      rule.weekdays = Read_int64_t(r);
+      rule.firstDay = Read_int64_t(r);
+      rule.lastDay = Read_int64_t(r);
+      rule.startTime = Read_int64_t(r);
+      rule.duration = Read_int64_t(r);
+      rule.title = Read_string(r);
+      int64_t exceptionsCount = Read_int64_t(r);
+      for (int64_t j = 0; j < exceptionsCount && !r.error; ++j) {
+        rule.exceptions.push_back(Read_int64_t(r));
+      }
+      if (!r.error && rule.frequency >= Recur_Count) r.error = "bad recurrence frequency";
+      if (!r.error) {
+        AddRecurrence(recurrences, std::move(rule));
+      }
+    }
+    return;
+  }
+
+  int64_t dateCount = tag;
+  if (dateCount < 0) r.error = "not a calendar file";
+  for (int64_t i = 0; i < dateCount && !r.error; ++i) {
+    Date d = Read_Date(r);
+    size_t meetingsCount = Read_int64_t(r);
+    for (int64_t j = 0; j < meetingsCount && !r.error; ++j) {
+      string meeting = Read_string(r);
+      if (!r.error) {
+        AppendMeeting(meetings, DateToMinutes(d), DateToMinutes(d) + MINUTES_PER_DAY, meeting);
+      }
+    }
+  }
+}
+
+// Checks the header and points the store at the mapped records and
+// titles; only the recurrence rules are decoded. Takes the same time for
+// any number of meetings. Returns the sequence number the snapshot
+// includes.
+uint64_t DecodeSnapshot(MappedFile file, MeetingStore& meetings, Recurrences& recurrences, const char*& error) {
+  shared_ptr<void> mapping = MappingOwner(file);
+  if (file.size == 0) return 0;
+
+  SnapshotHeader header = {};
+  if (file.size < sizeof(header) || memcmp(file.data, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+    Reader r = {};
+    r.bytes = file.data;
+    r.size = file.size;
+    DecodeLegacyMeetings(r, meetings, recurrences);
+    error = r.error;
+    return 0;
+  }
+
+  memcpy(&header, file.data, sizeof(header));
+  if (header.version != SNAPSHOT_VERSION) {
+    error = "unsupported snapshot version";
+    return 0;
+  }
+  if (header.fileSize != file.size ||
+      header.meetingsOffset % alignof(MeetingRecord) != 0 ||
+      header.meetingsOffset > file.size ||
+      header.meetingCount > (file.size - header.meetingsOffset) / sizeof(MeetingRecord) ||
+      header.meetingCount > UINT32_MAX ||
+      header.titlesOffset > file.size ||
+      header.titlesSize > file.size - header.titlesOffset ||
+      header.rulesOffset > file.size ||
+      header.rulesSize > file.size - header.rulesOffset) {
+    error = "snapshot sections out of bounds";
+    return 0;
+  }
+
+  meetings.records = (MeetingRecord const*)(file.data + header.meetingsOffset);
+  meetings.count = header.meetingCount;
+  meetings.titles = string_view(file.data + header.titlesOffset, header.titlesSize);
+  meetings.mapping = std::move(mapping);
+  meetings.rootLevel = meetings.count ? bit_width(meetings.count) - 1 : 0;
+  meetings.nextId = header.nextMeetingId;
+  ++meetings.version;
+
+  Reader r = {};
+  r.bytes = file.data + header.rulesOffset;
+  r.size = header.rulesSize;
+  recurrences.nextId = header.nextRuleId;
+  for (uint64_t i = 0; i < header.rulesCount && !r.error; ++i) {
+    RecurrenceRule rule = Read_RecurrenceRule(r);
+    if (!r.error) {
+      AddRecurrence(recurrences, std::move(rule));
+    }
+  }
+
+  error = r.error;
+  return header.sequence;
+}
+
+// Applies the records of a journal that come after sequence, collecting
+// removed meetings to drop in one pass. Returns the size of the intact
+// prefix and counts its records.
+size_t ReplayJournal(string& bytes, MeetingStore& meetings, Recurrences& recurrences, uint64_t& sequence, vector<uint64_t>& removedMeetings, int64_t& records) {
+  uint64_t skipThrough = sequence;
+  size_t offset = 0;
+  while (bytes.size() - offset >= 8) {
+    uint32_t size, checksum;
+    memcpy(&size, bytes.data() + offset, 4);
+    memcpy(&checksum, bytes.data() + offset + 4, 4);
+    if (size > bytes.size() - offset - 8 || Checksum(bytes.data() + offset + 8, size) != checksum) break;
+
+    Reader r = {};
+    r.bytes = bytes.data() + offset + 8;
+    r.size = size;
+    offset += 8 + size;
+    ++records;
+
+    uint64_t recordSequence = Read_int64_t(r);
+    int64_t op = Read_int64_t(r);
+    if (r.error || recordSequence <= skipThrough) continue;
+    sequence = max(sequence, recordSequence);
+
+    switch (op) {
+      case Journal_AddMeeting: {
+        uint64_t id = Read_int64_t(r);
+        Minutes start = Read_int64_t(r);
+        Minutes end = Read_int64_t(r);
+        string title = Read_string(r);
+        if (!r.error) AppendMeeting(meetings, start, end, title, id);
+      } break;
+      case Journal_RemoveMeeting: {
+        uint64_t id = Read_int64_t(r);
+        if (!r.error) removedMeetings.push_back(id);
+      } break;
+      case Journal_AddRule: {
+        RecurrenceRule rule = Read_RecurrenceRule(r);
+        if (!r.error) AddRecurrence(recurrences, std::move(rule));
+      } break;
+      case Journal_RemoveRule: {
+        uint64_t id = Read_int64_t(r);
+        if (!r.error) RemoveRecurrence(recurrences, id);
+      } break;
+      case Journal_AddException: {
+        uint64_t id = Read_int64_t(r);
+        int64_t day = Read_int64_t(r);
+        if (!r.error) AddRecurrenceException(recurrences, id, day);
+      } break;
+      default: break;
+    }
+  }
+  return offset;
+}
+
+void CompactCalendar(stop_token, Compaction& compaction) {
+  string bytes;
+  EncodeSnapshot(bytes, compaction.meetings, compaction.rules, compaction.nextRuleId, compaction.sequence);
+  compaction.ok = WriteFileAtomically(SAVE_PATH, bytes, compaction.status, sizeof(compaction.status));
+  if (compaction.ok) unlink(OLD_JOURNAL_PATH);
+  compaction.done = true;
+}
+
+unique_ptr<Compaction> SnapshotCompaction(App &app) {
+  auto compaction = make_unique<Compaction>();
+  compaction->meetings = app.meetings;  // Shares the mapped snapshot.
+  compaction->rules = app.recurrences.rules;
+  compaction->nextRuleId = app.recurrences.nextId;
+  compaction->sequence = app.journal.sequence;
+  return compaction;
+}
+
+int OpenJournal(App &app) {
+  int fd = open(JOURNAL_PATH, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+  if (fd == -1) {
+    snprintf(app.status, sizeof(app.status), "open %s: %s, changes will not be saved", JOURNAL_PATH, strerror(errno));
+  }
+  return fd;
+}
+
+// A leftover old journal means an earlier compaction did not finish, and
+// renaming over it would lose its records, so none starts until the next
+// load has folded it into a snapshot.
+void StartCompaction(App &app) {
+  Journal& journal = app.journal;
+  if (journal.compaction || journal.fd == -1 || access(OLD_JOURNAL_PATH, F_OK) == 0) return;
+
+  if (rename(JOURNAL_PATH, OLD_JOURNAL_PATH) == -1) {
+    snprintf(app.status, sizeof(app.status), "rename %s: %s", JOURNAL_PATH, strerror(errno));
+    return;
+  }
+  close(journal.fd);
+  journal.fd = OpenJournal(app);
+  SyncParentDirectory(JOURNAL_PATH, app.status, sizeof(app.status));
+  journal.size = 0;
+  journal.records = 0;
+
+  journal.compaction = SnapshotCompaction(app);
+  journal.compaction->worker = jthread(CompactCalendar, std::ref(*journal.compaction));
+}
+
+void PollCompaction(App &app) {
+  Compaction* compaction = app.journal.compaction.get();
+  if (!compaction || !compaction->done) return;
+
+  if (!compaction->ok) {
+    snprintf(app.status, sizeof(app.status), "Compaction failed: %s", compaction->status);
+  }
+  app.journal.compaction.reset();
+}
+
+// Loads the snapshot and replays the journals over it, cutting off a torn
+// record at the end of the current one. A leftover old journal is folded
+// into a new snapshot right away.
+void LoadCalendar(App &app) {
+  Journal& journal = app.journal;
+  journal.fd = -1;
+
+  MappedFile file = {};
+  if (access(SAVE_PATH, F_OK) == 0 && !MapFile(SAVE_PATH, file, app.status, sizeof(app.status))) return;
+
+  const char* error = nullptr;
+  journal.sequence = DecodeSnapshot(file, app.meetings, app.recurrences, error);
+  if (error) {
+    // Compacting over a snapshot we could not read would lose it.
+    snprintf(app.status, sizeof(app.status), "%s: %s, changes will not be saved", SAVE_PATH, error);
+    app.meetings = {};
+    app.recurrences = {};
+    return;
+  }
+
+  string bytes;
+  vector<uint64_t> removedMeetings;
+  int64_t oldRecords = 0;
+  bool oldJournal = access(OLD_JOURNAL_PATH, F_OK) == 0;
+  if (oldJournal) {
+    if (!ReadFile(OLD_JOURNAL_PATH, bytes, app.status, sizeof(app.status))) return;
+    ReplayJournal(bytes, app.meetings, app.recurrences, journal.sequence, removedMeetings, oldRecords);
+  }
+
+  if (!ReadFile(JOURNAL_PATH, bytes, app.status, sizeof(app.status))) return;
+  size_t intact = ReplayJournal(bytes, app.meetings, app.recurrences, journal.sequence, removedMeetings, journal.records);
+  if (intact < bytes.size() && truncate(JOURNAL_PATH, intact) == -1) {
+    snprintf(app.status, sizeof(app.status), "truncate %s: %s, changes will not be saved", JOURNAL_PATH, strerror(errno));
+    return;
+  }
+  journal.size = intact;
+
+  // The snapshot stays mapped as it is; only the journal's meetings are
+  // sorted, and its removals become tombstones.
+  SortMeetings(app.meetings);
+  sort(removedMeetings.begin(), removedMeetings.end());
+  RemoveMeetings(app.meetings, removedMeetings);
+
+  journal.fd = OpenJournal(app);
+  if (journal.fd != -1 && oldJournal) {
+    unique_ptr<Compaction> compaction = SnapshotCompaction(app);
+    CompactCalendar({}, *compaction);
+    if (!compaction->ok) {
+      snprintf(app.status, sizeof(app.status), "Compaction failed: %s", compaction->status);
+    } else if (ftruncate(journal.fd, 0) == 0) {
+      journal.size = 0;
+      journal.records = 0;
+    }
+  }
+}
+
+// Starts a record at the end of journal.buffer. EndRecord fills in its
+// header, and CommitRecords writes out the records since the last commit.
+string& BeginRecord(Journal& journal, JournalOp op) {
+  journal.recordStart = journal.buffer.size();
+  journal.buffer.append(8, '\0');
+  Write_int64_t(journal.buffer, journal.sequence + ++journal.pending);
+  Write_int64_t(journal.buffer, op);
+  return journal.buffer;
+}
+
+void EndRecord(Journal& journal) {
+  char* record = journal.buffer.data() + journal.recordStart;
+  uint32_t size = journal.buffer.size() - journal.recordStart - 8;
+  uint32_t checksum = Checksum(record + 8, size);
+  memcpy(record, &size, 4);
+  memcpy(record + 4, &checksum, 4);
+}
+
+// Appends the pending records with a single write. A failed write is cut
+// back off so later records stay readable.
+void CommitRecords(App &app) {
+  Journal& journal = app.journal;
+  string& records = journal.buffer;
+  int64_t count = journal.pending;
+  journal.pending = 0;
+
+  if (journal.fd == -1) {
+    snprintf(app.status, sizeof(app.status), "%s is not open, changes will not be saved", JOURNAL_PATH);
+    records.clear();
+    return;
+  }
+  if (!WriteAll(journal.fd, records.data(), records.size()) || fdatasync(journal.fd) == -1) {
+    snprintf(app.status, sizeof(app.status), "write %s: %s", JOURNAL_PATH, strerror(errno));
+    ftruncate(journal.fd, journal.size);
+    records.clear();
+    return;
+  }
+  journal.size += records.size();
+  journal.sequence += count;
+  journal.records += count;
+  records.clear();
+
+  if (journal.records >= COMPACT_JOURNAL_RECORDS) StartCompaction(app);
+}
+
+void RecordMeetingAdded(Journal& journal, uint64_t id, Minutes start, Minutes end, string_view title) {
+  string& record = BeginRecord(journal, Journal_AddMeeting);
+  Write_int64_t(record, id);
+  Write_int64_t(record, start);
+  Write_int64_t(record, end);
+  Write_string(record, title);
+  EndRecord(journal);
+}
+
+void RecordRuleAdded(Journal& journal, RecurrenceRule const& rule) {
+  string& record = BeginRecord(journal, Journal_AddRule);
+  Write_RecurrenceRule(record, rule);
+  EndRecord(journal);
+}
+
+void RecordExceptionAdded(Journal& journal, uint64_t ruleId, int64_t day) {
+  string& record = BeginRecord(journal, Journal_AddException);
+  Write_int64_t(record, ruleId);
+  Write_int64_t(record, day);
+  EndRecord(journal);
+}
+
+void LogMeetingAdded(App &app, uint64_t id, Minutes start, Minutes end, string_view title) {
+  RecordMeetingAdded(app.journal, id, start, end, title);
+  CommitRecords(app);
+}
+
+void LogMeetingRemoved(App &app, uint64_t id) {
+  string& record = BeginRecord(app.journal, Journal_RemoveMeeting);
+  Write_int64_t(record, id);
+  EndRecord(app.journal);
+  CommitRecords(app);
+}
+
+void LogRuleAdded(App &app, RecurrenceRule const& rule) {
+  RecordRuleAdded(app.journal, rule);
+  CommitRecords(app);
+}
+
+void LogRuleRemoved(App &app, uint64_t id) {
+  string& record = BeginRecord(app.journal, Journal_RemoveRule);
+  Write_int64_t(record, id);
+  EndRecord(app.journal);
+  CommitRecords(app);
+}
+
+void LogExceptionAdded(App &app, uint64_t ruleId, int64_t day) {
+  RecordExceptionAdded(app.journal, ruleId, day);
+  CommitRecords(app);
+}
+
+struct IcsEvent {
+  Minutes start, end, duration;
+  bool hasStart, hasEnd, hasDuration;
+  bool allDay;
+  bool hasRecurrenceId;
+  bool cancelled;
+  Minutes recurrenceId;  // Original start of the occurrence this event replaces.
+  string uid;
+  string summary;
+  string rrule;
+  vector<int64_t> exceptions;  // Day numbers.
+};
+
+struct IcsParser {
+  string physical;  // Start of a line cut off at the end of a chunk.
+  string logical;   // Line being unfolded.
+  bool haveLogical;
+
+  bool inEvent;
+  int depth;  // Components open inside the current VEVENT.
+  IcsEvent event;
+
+  IcsBatch batch;
+  uint64_t events;
+  uint64_t simplified;  // Recurring events kept as their first occurrence.
+  uint64_t overrides;   // Occurrences moved or cancelled by a RECURRENCE-ID.
+
+  // Rules are numbered in import order; batchFirstRule is the number of
+  // batch.rules[0]. Overrides seen before their rule wait in pending.
+  uint64_t rules;
+  uint64_t batchFirstRule;
+  map<string, uint64_t> ruleByUid;
+  map<string, vector<int64_t>> pending;
+};
+
+bool IcsNameIs(string_view name, string_view expected) {
+  if (name.size() != expected.size()) return false;
+  for (size_t i = 0; i < name.size(); ++i) {
+    if (toupper((unsigned char)name[i]) != expected[i]) return false;
+  }
+  return true;
+}
+
+bool ParseDigits(string_view text, size_t at, size_t count, int& out) {
+  if (text.size() < at + count) return false;
+  out = 0;
+  for (size_t i = at; i < at + count; ++i) {
+    if (text[i] < '0' || text[i] > '9') return false;
+    out = out*10 + (text[i] - '0');
+  }
+  return true;
+}
+
+// DATE (YYYYMMDD) or DATE-TIME (YYYYMMDDTHHMMSS, with a Z for UTC). UTC
+// times are moved to local time; times with a TZID are taken as local
+// wall-clock times.
+bool ParseIcsTime(string_view value, Minutes& out, bool& isDate) {
+  int year, month, day;
+  if (!ParseDigits(value, 0, 4, year) || !ParseDigits(value, 4, 2, month) || !ParseDigits(value, 6, 2, day)) return false;
+  if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+  Date date = { (int16_t)year, (int8_t)month, (int8_t)day };
+
+  isDate = value.size() == 8;
+  if (isDate) {
+    out = DateToMinutes(date);
+    return true;
+  }
+
+  int hour, minute, second;
+  if (value[8] != 'T' || !ParseDigits(value, 9, 2, hour) || !ParseDigits(value, 11, 2, minute) || !ParseDigits(value, 13, 2, second)) return false;
+  if (value.size() > 15 && value[15] == 'Z') {
+    time_t t = DayNumber(date)*86400 + hour*3600 + minute*60 + second;
+    struct tm local = {};
+    localtime_r(&t, &local);
+    date = { (int16_t)(local.tm_year + 1900), (int8_t)(local.tm_mon + 1), (int8_t)local.tm_mday };
+    hour = local.tm_hour;
+    minute = local.tm_min;
+  }
+  out = DateToMinutes(date) + hour*60 + minute;
+  return true;
+}
+
+// [+-]P[nW][nD][T[nH][nM][nS]]
+bool ParseIcsDuration(string_view value, Minutes& out) {
+  size_t i = 0;
+  bool negative = false;
+  if (i < value.size() && (value[i] == '+' || value[i] == '-')) negative = value[i++] == '-';
+  if (i >= value.size() || value[i++] != 'P') return false;
+
+  int64_t seconds = 0, n = 0;
+  for (; i < value.size(); ++i) {
+    char c = value[i];
+    if (c >= '0' && c <= '9') {
+      n = n*10 + (c - '0');
+      continue;
+    }
+    switch (c) {
+      case 'W': seconds += n*7*86400; break;
+      case 'D': seconds += n*86400; break;
+      case 'H': seconds += n*3600; break;
+      case 'M': seconds += n*60; break;
+      case 'S': seconds += n; break;
+      case 'T': break;
+      default: return false;
+    }
+    n = 0;
+  }
+  out = (negative ? -seconds : seconds) / 60;
+  return true;
+}
+
+void UnescapeIcsText(string_view value, string& out) {
+  out.clear();
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '\\' && i + 1 < value.size()) {
+      char c = value[++i];
+      out += (c == 'n' || c == 'N') ? '\n' : c;
+    } else {
+      out += value[i];
+    }
+  }
+}
+
+// Steps the rule through its first count occurrences, a stretch of days at
+// a time, and returns the day of the last one.
+int64_t NthOccurrenceDay(RecurrenceRule const& rule, int count) {
+  int64_t stretch = 400*int64_t(rule.interval);
+  vector<Occurrence> occurrences;
+  for (int64_t fromDay = rule.firstDay; fromDay <= rule.lastDay; fromDay += stretch) {
+    occurrences.clear();
+    ExpandRule(rule, fromDay, fromDay + stretch, occurrences);
+    if ((int64_t)occurrences.size() >= count) return occurrences[count - 1].start / MINUTES_PER_DAY;
+    count -= (int)occurrences.size();
+  }
+  return rule.lastDay;
+}
+
+// Maps the RRULE parts the store can express: FREQ=DAILY/WEEKLY/MONTHLY,
+// INTERVAL, UNTIL, COUNT, BYDAY for weekly rules, and a BYMONTHDAY equal to
+// the start's day.
+bool ParseIcsRule(string_view text, IcsEvent const& event, RecurrenceRule& rule) {
+  rule = {};
+  rule.interval = 1;
+  rule.firstDay = event.start / MINUTES_PER_DAY;
+  rule.lastDay = DayNumber({ MAX_YEAR, 12, 31 });
+  rule.startTime = event.start % MINUTES_PER_DAY;
+  rule.duration = event.end - event.start;
+
+  bool hasFrequency = false;
+  int count = 0;
+  while (!text.empty()) {
+    size_t semicolon = text.find(';');
+    string_view part = text.substr(0, semicolon);
+    text = semicolon == string_view::npos ? string_view() : text.substr(semicolon + 1);
+
+    size_t equals = part.find('=');
+    if (equals == string_view::npos) return false;
+    string_view key = part.substr(0, equals);
+    string_view value = part.substr(equals + 1);
+
+    if (IcsNameIs(key, "FREQ")) {
+      hasFrequency = true;
+      if (IcsNameIs(value, "DAILY")) rule.frequency = Recur_Daily;
+      else if (IcsNameIs(value, "WEEKLY")) rule.frequency = Recur_Weekly;
+      else if (IcsNameIs(value, "MONTHLY")) rule.frequency = Recur_Monthly;
+      else return false;
+    } else if (IcsNameIs(key, "INTERVAL")) {
+      if (from_chars(value.data(), value.data() + value.size(), rule.interval).ec != errc() || rule.interval < 1) return false;
+    } else if (IcsNameIs(key, "COUNT")) {
+      if (from_chars(value.data(), value.data() + value.size(), count).ec != errc() || count < 1) return false;
+    } else if (IcsNameIs(key, "UNTIL")) {
+      Minutes until;
+      bool isDate;
+      if (!ParseIcsTime(value, until, isDate)) return false;
+      Minutes lastStart = isDate ? until + rule.startTime : until;
+      rule.lastDay = (lastStart - rule.startTime) / MINUTES_PER_DAY;
+    } else if (IcsNameIs(key, "BYDAY")) {
+      while (!value.empty()) {
+        size_t comma = value.find(',');
+        string_view day = value.substr(0, comma);
+        value = comma == string_view::npos ? string_view() : value.substr(comma + 1);
+        int weekday = 0;
+        while (weekday < 7 && !IcsNameIs(day, WEEKDAY_NAMES_UPPER[weekday])) ++weekday;
+        if (weekday == 7) return false;  // Also rejects ordinals such as 2TU.
+        rule.weekdays |= 1 << weekday;
+      }
+    } else if (IcsNameIs(key, "BYMONTHDAY")) {
+      int day;
+      if (from_chars(value.data(), value.data() + value.size(), day).ec != errc() || day != DateFromDayNumber(rule.firstDay).day) return false;
+    } else if (IcsNameIs(key, "WKST")) {
+      if (!IcsNameIs(value, "MO")) return false;
+    } else {
+      return false;
+    }
+  }
+
+  if (!hasFrequency) return false;
+  if (rule.weekdays && rule.frequency != Recur_Weekly) return false;
+  if (rule.frequency == Recur_Weekly && rule.weekdays == 0) rule.weekdays = 1 << Weekday(rule.firstDay);
+  if (count && rule.frequency == Recur_Daily) {
+    rule.lastDay = min(rule.lastDay, rule.firstDay + int64_t(count - 1)*rule.interval);
+  } else if (count) {
+    rule.lastDay = NthOccurrenceDay(rule, count);
+  }
+  rule.title = event.summary;
+  rule.exceptions = event.exceptions;
+  return true;
+}
+
+void FinishIcsEvent(IcsParser& parser) {
+  IcsEvent& event = parser.event;
+  if (!event.hasStart) return;
+
+  if (!event.hasEnd) {
+    event.end = event.start + (event.hasDuration ? event.duration : event.allDay ? MINUTES_PER_DAY : 0);
+  }
+  event.end = max(event.end, event.start + 1);
+  ++parser.events;
+
+  // An override replaces one occurrence of the rule with the same UID: the
+  // occurrence becomes an exception and the event, unless cancelled, a
+  // meeting of its own.
+  if (event.hasRecurrenceId) {
+    ++parser.overrides;
+    int64_t day = event.recurrenceId / MINUTES_PER_DAY;
+    auto it = parser.ruleByUid.find(event.uid);
+    if (it == parser.ruleByUid.end()) {
+      parser.pending[event.uid].push_back(day);
+    } else if (it->second >= parser.batchFirstRule) {
+      parser.batch.rules[it->second - parser.batchFirstRule].exceptions.push_back(day);
+    } else {
+      parser.batch.exceptions.push_back({ it->second, day });
+    }
+    if (event.cancelled) return;
+  }
+
+  RecurrenceRule rule;
+  if (!event.rrule.empty() && !event.hasRecurrenceId) {
+    if (ParseIcsRule(event.rrule, event, rule)) {
+      if (!event.uid.empty()) {
+        auto it = parser.pending.find(event.uid);
+        if (it != parser.pending.end()) {
+          rule.exceptions.insert(rule.exceptions.end(), it->second.begin(), it->second.end());
+          parser.pending.erase(it);
         }
+        parser.ruleByUid[event.uid] = parser.rules;
       }
-      if (r.error) {
-        fprintf(stderr, "DeserializeMeetings: %s", r.error);
+      ++parser.rules;
+      parser.batch.rules.push_back(std::move(rule));
+      return;
+    }
+    ++parser.simplified;
+  }
+
+  MeetingRecord record = {};
+  record.start = event.start;
+  record.end = event.end;
+  record.titleOffset = parser.batch.titles.size();
+  record.titleSize = event.summary.size();
+  parser.batch.titles += event.summary;
+  parser.batch.meetings.push_back(record);
+}
+
+// name[;param=value...]:value, where a colon inside a quoted parameter
+// value doesn't end the name.
+void ParseIcsLine(IcsParser& parser, string_view line) {
+  size_t colon = 0;
+  bool quoted = false;
+  for (; colon < line.size(); ++colon) {
+    if (line[colon] == '"') quoted = !quoted;
+    else if (line[colon] == ':' && !quoted) break;
+  }
+  if (colon == line.size()) return;
+
+  string_view name = line.substr(0, min(colon, line.find(';')));
+  string_view value = line.substr(colon + 1);
+  IcsEvent& event = parser.event;
+
+  if (IcsNameIs(name, "BEGIN")) {
+    if (parser.inEvent) {
+      ++parser.depth;
+    } else if (IcsNameIs(value, "VEVENT")) {
+      parser.inEvent = true;
+      parser.depth = 0;
+      event.hasStart = event.hasEnd = event.hasDuration = event.allDay = false;
+      event.hasRecurrenceId = event.cancelled = false;
+      event.uid.clear();
+      event.summary.clear();
+      event.rrule.clear();
+      event.exceptions.clear();
+    }
+  } else if (IcsNameIs(name, "END")) {
+    if (parser.inEvent && parser.depth > 0) {
+      --parser.depth;
+    } else if (parser.inEvent && IcsNameIs(value, "VEVENT")) {
+      parser.inEvent = false;
+      FinishIcsEvent(parser);
+    }
+  } else if (!parser.inEvent || parser.depth > 0) {
+    return;
+  } else if (IcsNameIs(name, "DTSTART")) {
+    event.hasStart = ParseIcsTime(value, event.start, event.allDay);
+  } else if (IcsNameIs(name, "DTEND")) {
+    bool isDate;
+    event.hasEnd = ParseIcsTime(value, event.end, isDate);
+  } else if (IcsNameIs(name, "DURATION")) {
+    event.hasDuration = ParseIcsDuration(value, event.duration);
+  } else if (IcsNameIs(name, "SUMMARY")) {
+    UnescapeIcsText(value, event.summary);
+  } else if (IcsNameIs(name, "UID")) {
+    event.uid = value;
+  } else if (IcsNameIs(name, "RECURRENCE-ID")) {
+    bool isDate;
+    event.hasRecurrenceId = ParseIcsTime(value, event.recurrenceId, isDate);
+  } else if (IcsNameIs(name, "STATUS")) {
+    event.cancelled = IcsNameIs(value, "CANCELLED");
+  } else if (IcsNameIs(name, "RRULE")) {
+    event.rrule = value;
+  } else if (IcsNameIs(name, "EXDATE")) {
+    while (!value.empty()) {
+      size_t comma = value.find(',');
+      Minutes time;
+      bool isDate;
+      if (ParseIcsTime(value.substr(0, comma), time, isDate)) {
+        event.exceptions.push_back(time / MINUTES_PER_DAY);
       }
+      value = comma == string_view::npos ? string_view() : value.substr(comma + 1);
+    }
+  }
+}
+
+// Lines starting with a space or a tab continue the previous one.
+void ParseIcsPhysicalLine(IcsParser& parser, string_view line) {
+  if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+  if (!line.empty() && (line[0] == ' ' || line[0] == '\t')) {
+    if (parser.haveLogical) parser.logical.append(line.substr(1));
+    return;
+  }
+
+  if (parser.haveLogical) ParseIcsLine(parser, parser.logical);
+  parser.logical.assign(line);
+  parser.haveLogical = true;
+}
+
+// Parses what a chunk completes; last flushes the final line.
+void FeedIcs(IcsParser& parser, const char* data, size_t size, bool last) {
+  while (size > 0) {
+    const char* newline = (const char*)memchr(data, '\n', size);
+    if (!newline) {
+      parser.physical.append(data, size);
+      break;
+    }
+
+    size_t length = newline - data;
+    if (parser.physical.empty()) {
+      ParseIcsPhysicalLine(parser, string_view(data, length));
     } else {
-      perror("fread: ");
+      parser.physical.append(data, length);
+      ParseIcsPhysicalLine(parser, parser.physical);
+      parser.physical.clear();
     }
-    free(buffer);
-  } else {
-    perror("fsize: ");
+    data += length + 1;
+    size -= length + 1;
   }
 
-  fclose(f);
+  if (last) {
+    if (!parser.physical.empty()) ParseIcsPhysicalLine(parser, parser.physical);
+    parser.physical.clear();
+    if (parser.haveLogical) ParseIcsLine(parser, parser.logical);
+    parser.haveLogical = false;
+  }
+}
+
+void ImportIcs(stop_token stop, IcsImport& import) {
+  auto start = chrono::steady_clock::now();
+
+  int fd = open(import.path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    snprintf(import.status, sizeof(import.status), "open %s: %s", import.path.c_str(), strerror(errno));
+    import.done = true;
+    return;
+  }
+  struct stat st = {};
+  if (fstat(fd, &st) == 0) import.totalBytes = st.st_size;
+
+  IcsParser parser = {};
+  vector<char> chunk(1 << 16);
+  bool ok = true;
+  while (!stop.stop_requested()) {
+    ssize_t n = read(fd, chunk.data(), chunk.size());
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) {
+      snprintf(import.status, sizeof(import.status), "read %s: %s", import.path.c_str(), strerror(errno));
+      ok = false;
+      break;
+    }
+
+    FeedIcs(parser, chunk.data(), n, n == 0);
+    import.bytesRead += n;
+    import.events = parser.events;
+    if (n == 0 || parser.batch.meetings.size() + parser.batch.rules.size() >= ICS_BATCH_SIZE) {
+      lock_guard<mutex> lock(import.lock);
+      import.batches.push_back(std::move(parser.batch));
+      parser.batch = {};
+      parser.batchFirstRule = parser.rules;
+    }
+    if (n == 0) break;
+  }
+  close(fd);
+
+  if (ok) {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    snprintf(import.status, sizeof(import.status), "%s %llu events from %s in %.3f s (%llu recurring events kept as their first occurrence, %llu occurrences overridden)",
+      stop.stop_requested() ? "Cancelled after importing" : "Imported", (unsigned long long)parser.events, import.path.c_str(), seconds,
+      (unsigned long long)parser.simplified, (unsigned long long)parser.overrides);
+  }
+  import.done = true;
+}
+
+void StartIcsImport(App &app) {
+  app.import = make_unique<IcsImport>();
+  app.import->path = app.icsPath;
+  app.import->worker = jthread(ImportIcs, std::ref(*app.import));
+}
+
+void ApplyIcsBatch(App &app, IcsBatch& batch) {
+  size_t firstNew = app.meetings.ownedRecords.size();
+  for (MeetingRecord const& meeting : batch.meetings) {
+    string_view title = string_view(batch.titles).substr(meeting.titleOffset, meeting.titleSize);
+    uint64_t id = AppendMeeting(app.meetings, meeting.start, meeting.end, title);
+    RecordMeetingAdded(app.journal, id, meeting.start, meeting.end, title);
+  }
+  if (!batch.meetings.empty()) MergeMeetings(app.meetings, firstNew);
+
+  vector<uint64_t>& ruleIds = app.import->ruleIds;
+  for (RecurrenceRule& rule : batch.rules) {
+    ruleIds.push_back(AddRecurrence(app.recurrences, std::move(rule)));
+    RecordRuleAdded(app.journal, app.recurrences.rules.back());
+  }
+  for (IcsException const& exception : batch.exceptions) {
+    uint64_t id = ruleIds[exception.rule];
+    if (AddRecurrenceException(app.recurrences, id, exception.day)) RecordExceptionAdded(app.journal, id, exception.day);
+  }
+  CommitRecords(app);
+}
+
+// Batches pushed before done are all taken once done is seen.
+void PollIcsImport(App &app) {
+  IcsImport* import = app.import.get();
+  if (!import) return;
+
+  bool done = import->done;
+  vector<IcsBatch> batches;
+  {
+    lock_guard<mutex> lock(import->lock);
+    batches.swap(import->batches);
+  }
+  for (IcsBatch& batch : batches) {
+    ApplyIcsBatch(app, batch);
+  }
+
+  if (done) {
+    snprintf(app.status, sizeof(app.status), "%s", import->status);
+    app.import.reset();
+  }
+}
+
+// Events are written through a small buffer straight to the file, never
+// holding more than one buffer's worth.
+struct IcsWriter {
+  int fd;
+  bool ok;
+  string buffer;
+  string line;
+};
+
+void FlushIcs(IcsWriter& writer) {
+  if (writer.ok && !writer.buffer.empty()) writer.ok = WriteAll(writer.fd, writer.buffer.data(), writer.buffer.size());
+  writer.buffer.clear();
+}
 
-  return newMeetings;
+// Content lines are folded at 75 bytes, without splitting UTF-8 sequences.
+void WriteIcsLine(IcsWriter& writer, string_view line) {
+  size_t limit = 75;
+  while (line.size() > limit) {
+    size_t cut = limit;
+    while (cut > 1 && (line[cut] & 0xC0) == 0x80) --cut;
+    writer.buffer.append(line.substr(0, cut));
+    writer.buffer += "\r\n ";
+    line.remove_prefix(cut);
+    limit = 74;
+  }
+  writer.buffer.append(line);
+  writer.buffer += "\r\n";
+  if (writer.buffer.size() >= (1 << 16)) FlushIcs(writer);
+}
+
+void AppendIcsText(string& out, string_view text) {
+  for (char c : text) {
+    if (c == '\\' || c == ';' || c == ',') out += '\\';
+    if (c == '\n') out += "\\n";
+    else out += c;
+  }
+}
+
+// Floating local time, or a DATE for whole days.
+void AppendIcsTime(string& out, Minutes time, bool isDate) {
+  Date date = DateFromDayNumber(time / MINUTES_PER_DAY);
+  int minutes = time % MINUTES_PER_DAY;
+  char text[32];
+  if (isDate) snprintf(text, sizeof(text), "%04d%02d%02d", date.year, date.month, date.day);
+  else snprintf(text, sizeof(text), "%04d%02d%02dT%02d%02d00", date.year, date.month, date.day, minutes / 60, minutes % 60);
+  out += text;
+}
+
+void WriteIcsTimes(IcsWriter& writer, Minutes start, Minutes end) {
+  bool isDate = start % MINUTES_PER_DAY == 0 && end % MINUTES_PER_DAY == 0;
+  writer.line = isDate ? "DTSTART;VALUE=DATE:" : "DTSTART:";
+  AppendIcsTime(writer.line, start, isDate);
+  WriteIcsLine(writer, writer.line);
+  writer.line = isDate ? "DTEND;VALUE=DATE:" : "DTEND:";
+  AppendIcsTime(writer.line, end, isDate);
+  WriteIcsLine(writer, writer.line);
+}
+
+void WriteIcsEventStart(IcsWriter& writer, const char* kind, uint64_t id, const char* stamp, string_view title) {
+  WriteIcsLine(writer, "BEGIN:VEVENT");
+  char text[64];
+  snprintf(text, sizeof(text), "UID:%s-%llu@calendar", kind, (unsigned long long)id);
+  WriteIcsLine(writer, text);
+  WriteIcsLine(writer, stamp);
+  writer.line = "SUMMARY:";
+  AppendIcsText(writer.line, title);
+  WriteIcsLine(writer, writer.line);
+}
+
+bool ExportIcs(const char* path, MeetingStore const& meetings, Recurrences const& recurrences, char* status, size_t statusSize) {
+  auto start = chrono::steady_clock::now();
+
+  string tempPath;
+  IcsWriter writer = {};
+  writer.fd = CreateTempFile(path, tempPath, status, statusSize);
+  if (writer.fd == -1) return false;
+  writer.ok = true;
+
+  char stamp[32];
+  time_t now = time(nullptr);
+  struct tm utc = {};
+  gmtime_r(&now, &utc);
+  strftime(stamp, sizeof(stamp), "DTSTAMP:%Y%m%dT%H%M%SZ", &utc);
+
+  WriteIcsLine(writer, "BEGIN:VCALENDAR");
+  WriteIcsLine(writer, "VERSION:2.0");
+  WriteIcsLine(writer, "PRODID:-//imgui-stuff//Calendar//EN");
+
+  size_t exported = 0;
+  for (uint32_t i = 0; i < meetings.count + meetings.ownedRecords.size(); ++i) {
+    MeetingRecord const& meeting = MeetingAt(meetings, i);
+    if (i < meetings.count && MeetingRemoved(meetings, meeting.id)) continue;
+    ++exported;
+    WriteIcsEventStart(writer, "meeting", meeting.id, stamp, MeetingTitle(meetings, i));
+    WriteIcsTimes(writer, meeting.start, meeting.end);
+    WriteIcsLine(writer, "END:VEVENT");
+  }
+
+  for (RecurrenceRule const& rule : recurrences.rules) {
+    Minutes first = rule.firstDay*MINUTES_PER_DAY + rule.startTime;
+    bool isDate = rule.startTime == 0 && rule.duration % MINUTES_PER_DAY == 0;
+    WriteIcsEventStart(writer, "rule", rule.id, stamp, rule.title);
+    WriteIcsTimes(writer, first, first + rule.duration);
+
+    char text[64];
+    snprintf(text, sizeof(text), "RRULE:FREQ=%s;INTERVAL=%d", rule.frequency == Recur_Daily ? "DAILY" : rule.frequency == Recur_Weekly ? "WEEKLY" : "MONTHLY", rule.interval);
+    writer.line = text;
+    if (rule.frequency == Recur_Weekly) {
+      writer.line += ";BYDAY=";
+      for (int weekday = 0, n = 0; weekday < 7; ++weekday) {
+        if (!(rule.weekdays >> weekday & 1)) continue;
+        if (n++) writer.line += ',';
+        writer.line += WEEKDAY_NAMES_UPPER[weekday];
+      }
+    }
+    writer.line += ";UNTIL=";
+    AppendIcsTime(writer.line, rule.lastDay*MINUTES_PER_DAY + rule.startTime, isDate);
+    WriteIcsLine(writer, writer.line);
+
+    if (!rule.exceptions.empty()) {
+      writer.line = isDate ? "EXDATE;VALUE=DATE:" : "EXDATE:";
+      for (size_t j = 0; j < rule.exceptions.size(); ++j) {
+        if (j) writer.line += ',';
+        AppendIcsTime(writer.line, rule.exceptions[j]*MINUTES_PER_DAY + rule.startTime, isDate);
+      }
+      WriteIcsLine(writer, writer.line);
+    }
+    WriteIcsLine(writer, "END:VEVENT");
+  }
+
+  WriteIcsLine(writer, "END:VCALENDAR");
+  FlushIcs(writer);
+  if (!CommitTempFile(writer.fd, tempPath, path, writer.ok, status, statusSize)) return false;
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  snprintf(status, statusSize, "Exported %zu meetings and %zu recurring meetings to %s in %.3f s", exported, recurrences.rules.size(), path, seconds);
+  return true;
+}
+
+// Today() costs a time and a localtime call, so it runs on a timer rather
+// than every frame.
+const double TODAY_REFRESH_SECONDS = 30.0;
+
+void UpdateToday(App &app) {
+  double now = ImGui::GetTime();
+  if (now < app.todayRefreshTime) return;
+  app.today = Today();
+  app.todayRefreshTime = now + TODAY_REFRESH_SECONDS;
 }
 
 void DrawDatePicker(App &app) {
+  UpdateYearGrid(app.grid, app.selectedDate.year);
+
   ImGui::Text("Select a date: ");
   ImGui::SameLine();
   ImGui::PushItemWidth(60);
 
-  if (ImGui::BeginCombo("##day", to_string(app.selectedDate.day).data())) {
-    for (int8_t day = 1; day <= DaysInMonth(app.selectedDate.month, app.selectedDate.year); ++day) {
-      if (ImGui::Selectable(to_string(day).data(), day == app.selectedDate.day)) {
+  if (ImGui::BeginCombo("##day", DAY_LABELS[app.selectedDate.day])) {
+    for (int8_t day = 1; day <= app.grid.monthLengths[app.selectedDate.month - 1]; ++day) {
+      if (ImGui::Selectable(DAY_LABELS[day], day == app.selectedDate.day)) {
         app.selectedDate.day = day;
       }
     }
@@ -227,9 +2078,11 @@ void DrawDatePicker(App &app) {
 
   ImGui::SameLine();
 
-  if (ImGui::BeginCombo("##year", to_string(app.selectedDate.year).data())) {
+  if (ImGui::BeginCombo("##year", app.grid.yearLabel)) {
     for (int16_t year = MIN_YEAR; year <= MAX_YEAR; ++year) {
-      if (ImGui::Selectable(to_string(year).data(), year == app.selectedDate.year)) {
+      char label[8];
+      snprintf(label, sizeof(label), "%d", year);
+      if (ImGui::Selectable(label, year == app.selectedDate.year)) {
         app.selectedDate.year = year;
         app.selectedDate.day = min((int)app.selectedDate.day, DaysInMonth(app.selectedDate.month, app.selectedDate.year));
       }
@@ -250,22 +2103,29 @@ void DrawCalendar(App &app) {
   float originalFontSize = ImGui::GetFontSize();
   ImGui::SetWindowFontScale(2.0f);
 
-  Date today = Today();
+  UpdateYearGrid(app.grid, app.selectedDate.year);
+  UpdateDayBitmap(app.meetingDays, app.meetings, app.recurrences, app.selectedDate.year);
+  YearGrid const& grid = app.grid;
   for (int8_t month = 1; month <= 12; ++month) {
-    ImGui::Text("%s", MonthToShortString(month));
-      for (int8_t day = 1; day <= DaysInMonth(month, app.selectedDate.year); ++day) {
+    ImGui::TextUnformatted(MonthToShortString(month));
+      for (int8_t day = 1; day <= grid.monthLengths[month - 1]; ++day) {
         ImGui::SameLine();
 
         Date date = { app.selectedDate.year, month, day };
+        int dayOfYear = grid.firstDaysOfYear[month - 1] + day - 1;
+        int weekday = (grid.firstWeekdays[month - 1] + day - 1) % 7;
+        const char* label = DAY_LABELS[day];
 
-        if (date == today)
-          ImGui::TextColored(ImVec4(0.0F, 1.0F, 0.0F, 1.0F), "%d", day);
+        if (date == app.today)
+          ImGui::TextColored(ImVec4(0.0F, 1.0F, 0.0F, 1.0F), "%s", label);
         else if (date == app.selectedDate)
-          ImGui::TextColored(ImVec4(0.0F, 0.0F, 1.0F, 1.0F), "%d", day);
-        else if (app.meetings.contains(date))
-          ImGui::TextColored(ImVec4(1.0F, 0.0F, 0.0F, 1.0F), "%d", day);
+          ImGui::TextColored(ImVec4(0.0F, 0.0F, 1.0F, 1.0F), "%s", label);
+        else if (DayHasMeetings(app.meetingDays, dayOfYear))
+          ImGui::TextColored(ImVec4(1.0F, 0.0F, 0.0F, 1.0F), "%s", label);
+        else if (weekday >= 5)
+          ImGui::TextDisabled("%s", label);
         else
-          ImGui::Text("%d", day);
+          ImGui::TextUnformatted(label);
 
         if (ImGui::IsItemClicked()) {
           app.selectedDate = date;
@@ -279,7 +2139,12 @@ void DrawCalendar(App &app) {
 
 void DrawAddMeetingWindow(App &app) {
   static char meetingNameBuffer[128] = {};
-  ImVec2 meetingWindowSize = {300.0f, 100.0f};
+  static int startTime[2] = { 9, 0 };
+  static int endTime[2] = { 10, 0 };
+  static int repeat = -1;
+  static int repeatInterval = 1;
+  static bool repeatWeekdays[7] = {};
+  ImVec2 meetingWindowSize = {300.0f, 220.0f};
 
   ImGui::SetNextWindowSize(meetingWindowSize);
   ImGui::SetNextWindowPos(ImVec2(0.5f*(1280.0f - meetingWindowSize.x), 0.5f*(720.0f - meetingWindowSize.y)));
@@ -287,11 +2152,56 @@ void DrawAddMeetingWindow(App &app) {
   ImGui::Begin("###addMeeting", &app.addMeetingWindowOpen, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoScrollbar);
   ImGui::Text("Add meeting to %d.%s.%d", app.selectedDate.day, MonthToShortString(app.selectedDate.month), app.selectedDate.year);
   ImGui::InputText("Meeting Name", meetingNameBuffer, sizeof(meetingNameBuffer));
+  if (ImGui::InputInt2("Start (h m)", startTime)) {
+    startTime[0] = clamp(startTime[0], 0, 23);
+    startTime[1] = clamp(startTime[1], 0, 59);
+  }
+  if (ImGui::InputInt2("End (h m)", endTime)) {
+    endTime[0] = clamp(endTime[0], 0, 24);
+    endTime[1] = clamp(endTime[1], 0, 59);
+  }
+
+  if (ImGui::BeginCombo("Repeat", repeat < 0 ? "Never" : RECURRENCE_NAMES[repeat])) {
+    if (ImGui::Selectable("Never", repeat < 0)) repeat = -1;
+    for (int i = 0; i < Recur_Count; ++i) {
+      if (ImGui::Selectable(RECURRENCE_NAMES[i], repeat == i)) repeat = i;
+    }
+    ImGui::EndCombo();
+  }
+  if (repeat >= 0) {
+    if (ImGui::InputInt("Every", &repeatInterval)) repeatInterval = clamp(repeatInterval, 1, 365);
+  }
+  if (repeat == Recur_Weekly) {
+    for (int weekday = 0; weekday < 7; ++weekday) {
+      if (weekday) ImGui::SameLine();
+      ImGui::Checkbox(WEEKDAY_NAMES[weekday], &repeatWeekdays[weekday]);
+    }
+  }
 
   if (ImGui::Button("Save")) {
-    app.meetings[app.selectedDate].emplace_back(meetingNameBuffer);
+    // An end at or before the start is taken to be on the next day.
+    Minutes start = startTime[0]*60 + startTime[1];
+    Minutes end = endTime[0]*60 + endTime[1];
+    if (end <= start) end += MINUTES_PER_DAY;
+
+    if (repeat >= 0) {
+      RecurrenceRule rule = {};
+      rule.frequency = (RecurrenceFrequency)repeat;
+      rule.interval = repeatInterval;
+      for (int weekday = 0; weekday < 7; ++weekday) rule.weekdays |= repeatWeekdays[weekday] << weekday;
+      rule.firstDay = DayNumber(app.selectedDate);
+      rule.lastDay = DayNumber({ MAX_YEAR, 12, 31 });
+      rule.startTime = start;
+      rule.duration = end - start;
+      rule.title = meetingNameBuffer;
+      uint64_t id = AddRecurrence(app.recurrences, std::move(rule));
+      LogRuleAdded(app, *FindRule(app.recurrences, id));
+    } else {
+      Minutes day = DateToMinutes(app.selectedDate);
+      uint64_t id = AddMeeting(app.meetings, day + start, day + end, meetingNameBuffer);
+      LogMeetingAdded(app, id, day + start, day + end, meetingNameBuffer);
+    }
     memset(meetingNameBuffer, 0, sizeof(meetingNameBuffer));
-    SerializeMeetings(app);
     app.addMeetingWindowOpen = false;
   }
 
@@ -306,37 +2216,84 @@ void DrawAddMeetingWindow(App &app) {
 }
 
 void DrawMeetingList(App &app) {
-  if (app.meetings.empty()) {
+  if (!HasMeetings(app.meetings) && app.recurrences.rules.empty()) {
     ImGui::Text("No meetings at all.");
     return;
   }
 
   ImGui::Text("Meetings on %d.%s.%d: ", app.selectedDate.day, MonthToShortString(app.selectedDate.month), app.selectedDate.year);
 
-  if (!app.meetings.contains(app.selectedDate)) {
+  Minutes dayStart = DateToMinutes(app.selectedDate);
+  app.dayMeetings.clear();
+  QueryMeetings(app.meetings, dayStart, dayStart + MINUTES_PER_DAY, app.dayMeetings);
+  app.dayOccurrences.clear();
+  QueryOccurrences(app.recurrences, dayStart, dayStart + MINUTES_PER_DAY, app.dayOccurrences);
+
+  if (app.dayMeetings.empty() && app.dayOccurrences.empty()) {
     ImGui::Text("No meetings today.");
     return;
   }
 
-  if (app.meetings[app.selectedDate].empty()) {
-    ImGui::Text("No meetings today.");
-    return;
+  for (uint32_t i : app.dayMeetings) {
+    MeetingRecord const& meeting = MeetingAt(app.meetings, i);
+    string_view title = MeetingTitle(app.meetings, i);
+    int start = (meeting.start % MINUTES_PER_DAY + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+    int end = (meeting.end % MINUTES_PER_DAY + MINUTES_PER_DAY) % MINUTES_PER_DAY;
+    ImGui::BulletText("%02d:%02d-%02d:%02d %.*s", start / 60, start % 60, end / 60, end % 60, (int)title.size(), title.data());
+    if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
+      uint64_t id = meeting.id;
+      RemoveMeeting(app.meetings, id);
+      LogMeetingRemoved(app, id);
+      return;
+    }
   }
 
-  bool deletedMeetings = false;
-  for (const auto &meeting : app.meetings[app.selectedDate]) {
-    ImGui::BulletText("%s", meeting.data());
+  // Left click skips this occurrence, right click deletes the whole series.
+  for (Occurrence const& occurrence : app.dayOccurrences) {
+    RecurrenceRule* rule = FindRule(app.recurrences, occurrence.ruleId);
+    int start = occurrence.start % MINUTES_PER_DAY;
+    int end = occurrence.end % MINUTES_PER_DAY;
+    ImGui::BulletText("%02d:%02d-%02d:%02d %s (%s)", start / 60, start % 60, end / 60, end % 60, rule->title.data(), RECURRENCE_NAMES[rule->frequency]);
     if (ImGui::IsItemClicked(ImGuiMouseButton_Left)) {
-      bool deletedMeetings = true;
-      std::erase(app.meetings[app.selectedDate], meeting);
-      if (app.meetings[app.selectedDate].empty())
-        app.meetings.erase(app.selectedDate);
+      AddRecurrenceException(app.recurrences, rule->id, occurrence.start / MINUTES_PER_DAY);
+      LogExceptionAdded(app, rule->id, occurrence.start / MINUTES_PER_DAY);
       return;
     }
+    if (ImGui::IsItemClicked(ImGuiMouseButton_Right)) {
+      uint64_t id = rule->id;
+      RemoveRecurrence(app.recurrences, id);
+      LogRuleRemoved(app, id);
+      return;
+    }
+  }
+}
+
+void DrawIcsControls(App &app) {
+  ImGui::PushItemWidth(300);
+  ImGui::InputText("##icsPath", app.icsPath, sizeof(app.icsPath));
+  ImGui::PopItemWidth();
+  ImGui::SameLine();
+
+  if (app.import) {
+    IcsImport const& import = *app.import;
+    uint64_t total = import.totalBytes;
+    float fraction = total ? (float)import.bytesRead / total : 0.0f;
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.0f%%, %llu events", fraction*100.0f, (unsigned long long)import.events);
+    ImGui::ProgressBar(fraction, ImVec2(300.0f, 0.0f), overlay);
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) {
+      app.import.reset();
+      snprintf(app.status, sizeof(app.status), "Import cancelled");
+    }
+    return;
   }
 
-  if (deletedMeetings)
-    SerializeMeetings(app);
+  if (ImGui::Button("Import .ics") && app.icsPath[0])
+    StartIcsImport(app);
+  ImGui::SameLine();
+  if (ImGui::Button("Export .ics") && app.icsPath[0])
+    ExportIcs(app.icsPath, app.meetings, app.recurrences, app.status, sizeof(app.status));
 }
 
 void AppInit(App& app, float w, float h) {
@@ -344,8 +2301,10 @@ void AppInit(App& app, float w, float h) {
     app.w = w;
     app.h = h;
 
-    app.selectedDate = Today();
-    app.meetings = std::move(DeserializeMeetings());
+    app.today = Today();
+    app.selectedDate = app.today;
+    strncpy(app.icsPath, "calendar.ics", sizeof(app.icsPath) - 1);
+    LoadCalendar(app);
 }
 
 void AppUpdateAndRender(App& app) {
@@ -354,12 +2313,22 @@ void AppUpdateAndRender(App& app) {
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
     ImGui::Begin("Calendar", nullptr, flags);
 
+    UpdateToday(app);
+    PollCompaction(app);
+    PollIcsImport(app);
+
     DrawDatePicker(app);
+    DrawIcsControls(app);
     ImGui::Separator();
     DrawCalendar(app);
     ImGui::Separator();
     DrawMeetingList(app);
 
+    if (app.status[0]) {
+      ImGui::Separator();
+      ImGui::Text("%s", app.status);
+    }
+
     if (app.addMeetingWindowOpen)
       DrawAddMeetingWindow(app);
 
@@ -1,54 +1,3242 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+
+#include <string_view>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <type_traits>
 #include <vector>
 
-#include "implot.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "implot.h"
+
+using namespace std;
+
+size_t MAX_ROW_COUNT = 30;
+size_t MAX_COL_COUNT = 30;
+const char* SAVE_PATH = "csvtool.csv";
+const char* SNAPSHOT_PATH = "csvtool.snap";
+
+auto POPUP_FLAGS = ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoScrollbar;
+
+// Growable array of plain values. Grows geometrically like vector but with
+// realloc, and new elements are zeroed rather than constructed. An array
+// can also borrow memory it doesn't own, such as a private file mapping;
+// it then never frees it and moves to the heap the first time it grows.
+template <typename T>
+struct Array {
+  static_assert(is_trivially_copyable_v<T>);
+
+  T* data = nullptr;
+  size_t count = 0;
+  size_t capacity = 0;
+  bool borrowed = false;
+
+  Array() = default;
+  Array(Array const&) = delete;
+  Array& operator=(Array const&) = delete;
+  Array(Array&& other) noexcept : data(other.data), count(other.count), capacity(other.capacity), borrowed(other.borrowed) {
+    other.data = nullptr;
+    other.count = other.capacity = 0;
+    other.borrowed = false;
+  }
+  Array& operator=(Array&& other) noexcept {
+    if (this != &other) {
+      if (!borrowed) free(data);
+      data = other.data;
+      count = other.count;
+      capacity = other.capacity;
+      borrowed = other.borrowed;
+      other.data = nullptr;
+      other.count = other.capacity = 0;
+      other.borrowed = false;
+    }
+    return *this;
+  }
+  ~Array() { if (!borrowed) free(data); }
+
+  T& operator[](size_t i) { return data[i]; }
+  T const& operator[](size_t i) const { return data[i]; }
+
+  void borrow(T* memory, size_t n) {
+    *this = {};
+    data = memory;
+    count = capacity = n;
+    borrowed = true;
+  }
+
+  void reserve(size_t n) {
+    if (n <= capacity) return;
+    if (borrowed) {
+      T* heap = (T*)malloc(n*sizeof(T));
+      if (!heap) {
+        perror("Array: malloc: ");
+        abort();
+      }
+      if (count) memcpy(heap, data, count*sizeof(T));
+      data = heap;
+      capacity = n;
+      borrowed = false;
+      return;
+    }
+    T* newData = (T*)realloc(data, n*sizeof(T));
+    if (!newData) {
+      perror("Array: realloc: ");
+      abort();
+    }
+    data = newData;
+    capacity = n;
+  }
+
+  void resize(size_t n) {
+    if (n > capacity) reserve(max(n, capacity*2));
+    if (n > count) memset(data + count, 0, (n - count)*sizeof(T));
+    count = n;
+  }
+
+  void push_back(T value) {
+    if (count == capacity) reserve(max((size_t)16, capacity*2));
+    data[count++] = value;
+  }
+
+  void shrink_to_fit() {
+    if (count == capacity || borrowed) return;
+    if (count == 0) {
+      free(data);
+      data = nullptr;
+      capacity = 0;
+      return;
+    }
+    if (T* newData = (T*)realloc(data, count*sizeof(T))) {
+      data = newData;
+      capacity = count;
+    }
+  }
+};
+
+enum ColumnType : uint8_t {
+  Column_Int64,
+  Column_Double,
+  Column_String,
+};
+
+// One contiguous array per column. Only the arrays matching the column type
+// are used. Strings live back to back in chars, addressed per row by offset
+// and length so that a cell can be rewritten without moving its neighbours.
+struct Column {
+  ColumnType type;
+  string name;
+
+  Array<int64_t> ints;
+  Array<double> doubles;
+  Array<char> chars;
+  Array<uint64_t> offsets;
+  Array<uint32_t> lengths;
+
+  Array<uint64_t> valid;  // bit per row, cleared for null cells
+};
+
+struct Table {
+  vector<Column> columns;
+  size_t rowCount;
+  shared_ptr<void> mapping;  // backs borrowed column arrays, if any
+};
+
+constexpr float CELL_WIDTH = 110.0f;
+// Rows the table's scroll range covers at most, so that float scroll
+// positions stay a pixel apart. Longer tables map the scroll fraction
+// onto their rows.
+constexpr size_t TABLE_SCROLL_ROWS = 1 << 19;
+constexpr float ROW_HEADER_WIDTH = 80.0f;
+constexpr size_t CELL_CACHE_SIZE = 1 << 16;
+
+// Formatted text of recently drawn cells, direct-mapped on (row, col). An
+// entry stays valid until that cell is edited or the table is replaced.
+struct CellCacheEntry {
+  uint64_t row;
+  uint32_t col;
+  uint8_t length;
+  char text[51];
+};
+
+// Statistics of a numeric column. The sorted copy of its non-null values
+// gives min, max and quantiles, and lets a single edit update everything
+// with one erase and one insert instead of a rescan.
+struct ColumnStats {
+  bool numeric;
+  size_t count;
+  double sum;
+  double mean;
+  double m2;  // sum of squared deviations from the mean
+  vector<double> sorted;
+};
+
+constexpr double STATS_QUANTILES[4] = { 0.25, 0.5, 0.75, 0.99 };
+
+// What the stats panel shows of a column, as the query worker publishes it.
+struct ColumnSummary {
+  bool numeric;
+  size_t count;
+  double sum, mean, stddev, min, max;
+  double quantiles[4];  // at STATS_QUANTILES
+};
+
+// A cell rewritten by a formula recalculation, as numbers (NAN for null).
+struct CellChange {
+  uint32_t col;
+  double oldValue;
+  double newValue;
+};
+
+struct GroupRow {
+  string key;
+  size_t rows;
+  size_t count;  // non-null values
+  double sum, min, max;
+};
+
+constexpr size_t FILTER_BLOCK_ROWS = 4096;
+
+enum CompareOp {
+  Compare_Eq,
+  Compare_Ne,
+  Compare_Lt,
+  Compare_Le,
+  Compare_Gt,
+  Compare_Ge,
+};
+
+enum FilterOpKind {
+  Filter_Compare,
+  Filter_And,
+  Filter_Or,
+  Filter_Not,
+};
+
+// One step of a compiled filter. Plans are postfix: a comparison pushes the
+// row mask of a whole block, the logical ops combine the masks on top.
+struct FilterOp {
+  FilterOpKind kind;
+  CompareOp compare;
+  uint32_t col;
+  bool isText;
+  double number;
+  string text;
+};
+
+struct FilterPlan {
+  vector<FilterOp> ops;
+  size_t stackDepth;
+};
+
+struct QueryRequest {
+  Table const* table;
+  FilterPlan filter;
+  int sortCol;  // -1 keeps table order
+  bool descending;
+};
+
+// Filtering, sorting and column statistics run on a worker that reads the
+// table unlocked, so the UI keeps it read-only until `finished` catches up
+// with `requested` and `statsFinished` with `statsRequested`.
+struct QueryWorker {
+  mutex lock;
+  condition_variable_any wakeup;
+  QueryRequest request;  // guarded by lock
+  vector<uint32_t> rows;  // guarded by lock, result of `finished`
+  double seconds;        // guarded by lock
+
+  atomic<uint64_t> requested;
+  atomic<uint64_t> finished;
+
+  // The stats stay on the worker: a request rescans every column or folds
+  // changed cells in, then a summary per column is handed back.
+  Table const* statsTable;          // guarded by lock
+  bool statsRescan;                 // guarded by lock
+  vector<CellChange> statsChanges;  // guarded by lock
+  vector<ColumnSummary> summaries;  // guarded by lock, result of `statsFinished`
+  vector<ColumnStats> stats;        // worker only
+
+  atomic<uint64_t> statsRequested;
+  atomic<uint64_t> statsFinished;
+
+  jthread worker;
+};
+
+enum FormulaOp {
+  Formula_Number,
+  Formula_Cell,
+  Formula_Range,  // only as a function argument
+  Formula_Add,
+  Formula_Sub,
+  Formula_Mul,
+  Formula_Div,
+  Formula_Neg,
+  Formula_Sum,
+  Formula_Average,
+  Formula_Min,
+  Formula_Max,
+  Formula_Count,
+};
+
+// A block of cells, bounds inclusive.
+struct FormulaRef {
+  uint32_t rowBegin, rowEnd;
+  uint32_t colBegin, colEnd;
+};
+
+// Binary and unary ops take their operands from nodes a and b. Functions
+// take args[a .. a + b).
+struct FormulaNode {
+  FormulaOp op;
+  uint32_t a, b;
+  double number;
+  FormulaRef ref;
+};
+
+struct Formula {
+  uint64_t cell;  // CellKey, UINT64_MAX when the slot is free
+  string text;
+  vector<FormulaNode> nodes;  // operands before their op, root last
+  vector<uint32_t> args;
+  vector<FormulaRef> refs;    // what the formula reads, deduplicated
+  const char* error;          // set when the last evaluation failed
+  double value;               // result of the last evaluation
+  bool held;                  // value isn't in the cell: its int column can't hold it
+};
+
+struct RangeDependency {
+  uint32_t rowBegin, rowEnd;
+  uint32_t formula;
+};
+
+// Formula cells and the dependency graph between them. Edges are stored
+// from a cell to the formulas reading it: single-cell references in a hash
+// map, ranges per column sorted by first row with a running max of the
+// last row, so the ranges covering a cell are found with a binary search
+// and a short backward scan.
+struct FormulaSheet {
+  vector<Formula> formulas;
+  vector<uint32_t> freeSlots;
+  unordered_map<uint64_t, uint32_t> byCell;
+  vector<size_t> columnCounts;  // formulas per column
+
+  unordered_map<uint64_t, vector<uint32_t>> cellDependents;
+  vector<vector<RangeDependency>> rangeDependents;
+  vector<vector<uint32_t>> rangeReach;
+  bool rangesDirty;  // bulk inserts append unsorted, sorted before use
+
+  // Recalculation scratch, indexed by formula.
+  vector<uint32_t> visited;
+  vector<uint32_t> indegree;
+  uint32_t epoch;
+};
+
+struct CsvStream;
+
+struct App {
+  float w, h;
+
+  Table table;
+  FormulaSheet formulas;
+  unique_ptr<CsvStream> stream;
+  vector<CellCacheEntry> cellCache;
+
+  bool showStats;
+  bool statsActive;             // the worker keeps stats for this table
+  vector<ColumnSummary> stats;  // latest the worker handed back
+  uint64_t statsGeneration;
+  uint64_t statsResetAt;        // stats requests up to this one are stale
+  int groupKeyCol;
+  int groupValueCol;
+  vector<GroupRow> groups;
+
+  unique_ptr<QueryWorker> query;
+  char filterText[256];
+  char queryStatus[128];
+  int sortCol;
+  bool sortDescending;
+  bool viewActive;          // rows are shown through viewRows
+  vector<uint32_t> viewRows;
+  uint64_t viewGeneration;
+  uint64_t viewResetAt;     // requests up to this one were dropped by a reset
+  char appliedFilter[256];  // filter text of the active view
+
+  char csvPath[256];
+  bool hasHeader;
+  bool binary;
+  bool compress;
+  char status[256];
+
+  size_t clickedRow;
+  size_t clickedCol;
+  char editBuffer[256];
+
+  double topRow;         // first row shown, its fraction scrolled off
+  float mappedScrollY;   // scroll position topRow was last mapped from
+};
+
+void RunQueries(stop_token stop, QueryWorker& q);
+
+void AppInit(App& app, float w, float h) {
+    app = {};
+    app.w = w;
+    app.h = h;
+
+    strncpy(app.csvPath, SAVE_PATH, sizeof(app.csvPath) - 1);
+
+    app.sortCol = -1;
+    app.query = make_unique<QueryWorker>();
+    app.query->worker = jthread(RunQueries, std::ref(*app.query));
+}
+
+bool CellIsNull(Column const& col, size_t row) {
+  return !(col.valid[row / 64] >> (row % 64) & 1);
+}
+
+void SetCellValid(Column& col, size_t row, bool isValid) {
+  uint64_t bit = (uint64_t)1 << (row % 64);
+  if (isValid) col.valid[row / 64] |= bit;
+  else col.valid[row / 64] &= ~bit;
+}
+
+string_view CellString(Column const& col, size_t row) {
+  return string_view(col.chars.data + col.offsets[row], col.lengths[row]);
+}
+
+void ColumnResize(Column& col, size_t rowCount) {
+  size_t oldCount = col.type == Column_String ? col.offsets.count : col.type == Column_Int64 ? col.ints.count : col.doubles.count;
+
+  switch (col.type) {
+    case Column_Int64 : col.ints.resize(rowCount); break;
+    case Column_Double: col.doubles.resize(rowCount); break;
+    case Column_String: col.offsets.resize(rowCount); col.lengths.resize(rowCount); break;
+  }
+
+  // Rows that come back after a shrink must not inherit stale valid bits.
+  col.valid.resize((rowCount + 63) / 64);
+  for (size_t row = oldCount; row < rowCount && row % 64; ++row) {
+    SetCellValid(col, row, false);
+  }
+}
+
+int FormatCell(Column const& col, size_t row, char* buffer, size_t size) {
+  if (CellIsNull(col, row)) return 0;
+
+  switch (col.type) {
+    case Column_Int64 : return to_chars(buffer, buffer + size, col.ints[row]).ptr - buffer;
+    case Column_Double: return to_chars(buffer, buffer + size, col.doubles[row]).ptr - buffer;
+    case Column_String: {
+      string_view s = CellString(col, row);
+      size_t n = min(s.size(), size);
+      memcpy(buffer, s.data(), n);
+      return n;
+    }
+  }
+  return 0;
+}
+
+double CellAsDouble(Column const& col, size_t row) {
+  if (CellIsNull(col, row)) return NAN;
+  switch (col.type) {
+    case Column_Int64 : return (double)col.ints[row];
+    case Column_Double: return col.doubles[row];
+    case Column_String: return NAN;
+  }
+  return NAN;
+}
+
+void AppendString(Column& col, size_t row, string_view s) {
+  col.offsets[row] = col.chars.count;
+  col.lengths[row] = s.size();
+  if (s.empty()) return;
+  col.chars.resize(col.chars.count + s.size());
+  memcpy(col.chars.data + col.offsets[row], s.data(), s.size());
+}
+
+// Rewrites the cell's text in its old slot when it fits, so a cell that is
+// set over and over, like a recalculated formula, doesn't grow the arena.
+// Borrowed arenas are left alone: their slots may overlap.
+void StoreString(Column& col, size_t row, string_view s) {
+  if (col.chars.borrowed || s.size() > col.lengths[row]) {
+    AppendString(col, row, s);
+    return;
+  }
+  col.lengths[row] = s.size();
+  if (!s.empty()) memcpy(col.chars.data + col.offsets[row], s.data(), s.size());
+}
+
+// Widens a column in place: int64 -> double -> string. Never narrows.
+void PromoteColumn(Column& col, ColumnType type) {
+  if (type <= col.type) return;
+
+  size_t rowCount = col.type == Column_Int64 ? col.ints.count : col.doubles.count;
+  if (type == Column_Double) {
+    col.doubles.resize(rowCount);
+    for (size_t row = 0; row < rowCount; ++row) col.doubles[row] = (double)col.ints[row];
+    col.ints = {};
+  } else {
+    col.offsets.resize(rowCount);
+    col.lengths.resize(rowCount);
+    char buffer[64];
+    for (size_t row = 0; row < rowCount; ++row) {
+      int n = FormatCell(col, row, buffer, sizeof(buffer));
+      AppendString(col, row, string_view(buffer, n));
+    }
+    col.ints = {};
+    col.doubles = {};
+  }
+  col.type = type;
+}
+
+void SetCellNull(Column& col, size_t row) {
+  SetCellValid(col, row, false);
+}
+
+void SetCellInt(Column& col, size_t row, int64_t value) {
+  switch (col.type) {
+    case Column_Int64 : col.ints[row] = value; break;
+    case Column_Double: col.doubles[row] = (double)value; break;
+    case Column_String: {
+      char buffer[32];
+      StoreString(col, row, string_view(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer));
+    } break;
+  }
+  SetCellValid(col, row, true);
+}
+
+void SetCellDouble(Column& col, size_t row, double value) {
+  if (col.type == Column_Int64) PromoteColumn(col, Column_Double);
+  if (col.type == Column_Double) {
+    col.doubles[row] = value;
+  } else {
+    char buffer[32];
+    StoreString(col, row, string_view(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer));
+  }
+  SetCellValid(col, row, true);
+}
+
+void SetCellString(Column& col, size_t row, string_view value) {
+  PromoteColumn(col, Column_String);
+  StoreString(col, row, value);
+  SetCellValid(col, row, true);
+}
+
+// Stores text as the narrowest type that parses all of it. A string column
+// keeps the text as written, so "007" stays "007".
+void SetCellFromText(Column& col, size_t row, string_view text) {
+  if (text.empty()) {
+    SetCellNull(col, row);
+    return;
+  }
+  if (col.type == Column_String) {
+    SetCellString(col, row, text);
+    return;
+  }
+
+  const char* end = text.data() + text.size();
+  int64_t i = 0;
+  if (auto [ptr, ec] = from_chars(text.data(), end, i); ec == errc() && ptr == end) {
+    SetCellInt(col, row, i);
+    return;
+  }
+  double d = 0.0;
+  if (auto [ptr, ec] = from_chars(text.data(), end, d); ec == errc() && ptr == end) {
+    SetCellDouble(col, row, d);
+    return;
+  }
+  SetCellString(col, row, text);
+}
+
+uint64_t CellKey(size_t row, size_t col) {
+  return (uint64_t)row << 24 | col;
+}
+
+void TableResize(Table& table, size_t rowCount, size_t colCount) {
+  size_t oldColCount = table.columns.size();
+  table.columns.resize(colCount);
+  for (size_t col = 0; col < colCount; ++col) {
+    if (col >= oldColCount) table.columns[col].type = Column_Int64;
+    ColumnResize(table.columns[col], rowCount);
+  }
+  table.rowCount = rowCount;
+}
+
+void TableAppendRow(Table& table) {
+  ++table.rowCount;
+  for (auto& col : table.columns) ColumnResize(col, table.rowCount);
+}
+
+void TableAppendColumn(Table& table) {
+  table.columns.emplace_back();
+  table.columns.back().type = Column_Int64;
+  ColumnResize(table.columns.back(), table.rowCount);
+}
+
+void TableShrinkToFit(Table& table) {
+  for (auto& col : table.columns) {
+    col.ints.shrink_to_fit();
+    col.doubles.shrink_to_fit();
+    col.chars.shrink_to_fit();
+    col.offsets.shrink_to_fit();
+    col.lengths.shrink_to_fit();
+    col.valid.shrink_to_fit();
+  }
+}
+
+size_t ColumnRowCount(Column const& col) {
+  switch (col.type) {
+    case Column_Int64 : return col.ints.count;
+    case Column_Double: return col.doubles.count;
+    case Column_String: return col.offsets.count;
+  }
+  return 0;
+}
+
+size_t ThreadCount() {
+  return max(1u, thread::hardware_concurrency());
+}
+
+// Runs body(i) for every i in [0, count), each on its own thread, and waits.
+template <typename F>
+void ParallelFor(size_t count, F const& body) {
+  vector<jthread> threads;
+  for (size_t i = 1; i < count; ++i) threads.emplace_back([&body, i] { body(i); });
+  if (count > 0) body(0);
+}
+
+struct MappedFile {
+  const char* data;
+  size_t size;
+};
+
+// Pass PROT_READ | PROT_WRITE for a copy-on-write view that can be edited
+// in memory without touching the file.
+bool MapFile(const char* path, MappedFile& file, char* error, size_t errorSize, int protection = PROT_READ) {
+  file = {};
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    snprintf(error, errorSize, "open %s: %s", path, strerror(errno));
+    return false;
+  }
+
+  struct stat st = {};
+  if (fstat(fd, &st) == -1) {
+    snprintf(error, errorSize, "fstat %s: %s", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  file.size = st.st_size;
+  if (file.size > 0) {
+    void* data = mmap(nullptr, file.size, protection, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      snprintf(error, errorSize, "mmap %s: %s", path, strerror(errno));
+      close(fd);
+      return false;
+    }
+    file.data = (const char*)data;
+  }
+
+  close(fd);
+  return true;
+}
+
+void UnmapFile(MappedFile& file) {
+  if (file.data) munmap((void*)file.data, file.size);
+  file = {};
+}
+
+// Bit i of quotes/delimiters is set when byte i of the 16 byte block is a
+// quote, or a separator or newline. Most blocks have no bits set at all and
+// are skipped whole.
+void ScanBlock(const char* block, char separator, uint32_t& quotes, uint32_t& delimiters) {
+#ifdef __SSE2__
+  __m128i bytes = _mm_loadu_si128((const __m128i*)block);
+  quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')));
+  delimiters = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(separator)),
+                                              _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))));
+#else
+  quotes = delimiters = 0;
+  for (int i = 0; i < 16; ++i) {
+    quotes |= (uint32_t)(block[i] == '"') << i;
+    delimiters |= (uint32_t)(block[i] == separator || block[i] == '\n') << i;
+  }
+#endif
+}
+
+size_t CountQuotes(const char* begin, const char* end) {
+  size_t count = 0;
+  uint32_t quotes, delimiters;
+  for (const char* p = begin; p < end; p += 16) {
+    if (end - p >= 16) {
+      ScanBlock(p, ',', quotes, delimiters);
+      count += popcount(quotes);
+    } else {
+      for (const char* q = p; q < end; ++q) count += *q == '"';
+    }
+  }
+  return count;
+}
+
+// Returns the position just past the first newline at or after p that is
+// not inside a quoted field, given whether p itself is inside quotes.
+const char* NextRowStart(const char* p, const char* end, bool inQuotes) {
+  for (; p < end; ++p) {
+    if (*p == '"') inQuotes = !inQuotes;
+    else if (*p == '\n' && !inQuotes) return p + 1;
+  }
+  return end;
+}
+
+string_view UnquoteField(string_view text, string& scratch) {
+  if (text.size() >= 2 && text.back() == '"') text = text.substr(1, text.size() - 2);
+  else text = text.substr(1);
+
+  if (text.find('"') == string_view::npos) return text;
+
+  scratch.clear();
+  for (size_t i = 0; i < text.size(); ++i) {
+    scratch.push_back(text[i]);
+    if (text[i] == '"' && i + 1 < text.size() && text[i + 1] == '"') ++i;
+  }
+  return scratch;
+}
+
+struct CsvChunk {
+  const char* begin;
+  const char* end;
+  Table table;
+  size_t raggedRows;
+  vector<bool> keepText;  // Columns whose fields are all stored as written.
+  bool promoted;          // A column turned into strings after holding numbers.
+};
+
+// Parses whole rows in [begin, end) into the chunk's own table. Numbers go
+// through from_chars via SetCellFromText, quoted fields are always strings.
+void ParseCsvFields(CsvChunk& chunk, char separator) {
+  Table& table = chunk.table;
+  string scratch;
+
+  size_t row = 0, col = 0, firstRowFieldCount = 0;
+  const char* fieldStart = chunk.begin;
+  bool inQuotes = false;
+  bool quoted = false;
+
+  auto endField = [&](const char* fieldEnd, bool endsRow) {
+    string_view text(fieldStart, fieldEnd - fieldStart);
+    if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+    // A trailing separator adds no column (older saves ended rows with one).
+    if (endsRow && text.empty() && !quoted && col > 0) return;
+
+    if (col >= table.columns.size()) {
+      table.columns.emplace_back();
+      table.columns.back().type = Column_Int64;
+    }
+    Column& column = table.columns[col];
+    if (ColumnRowCount(column) <= row) ColumnResize(column, row + 1);
+
+    ColumnType type = column.type;
+    if (quoted) SetCellString(column, row, UnquoteField(text, scratch));
+    else if (text.empty()) {}
+    else if (col < chunk.keepText.size() && chunk.keepText[col]) SetCellString(column, row, text);
+    else SetCellFromText(column, row, text);
+    chunk.promoted = chunk.promoted || (row > 0 && type != Column_String && column.type == Column_String);
+    ++col;
+  };
+
+  auto endRow = [&]() {
+    if (row == 0) firstRowFieldCount = col;
+    else if (col != firstRowFieldCount) ++chunk.raggedRows;
+    ++row;
+    col = 0;
+  };
+
+  char padded[16];
+  for (const char* p = chunk.begin; p < chunk.end; p += 16) {
+    const char* block = p;
+    if (chunk.end - p < 16) {
+      memset(padded, 0, sizeof(padded));
+      memcpy(padded, p, chunk.end - p);
+      block = padded;
+    }
+
+    uint32_t quotes, delimiters;
+    ScanBlock(block, separator, quotes, delimiters);
+
+    for (uint32_t bits = quotes | delimiters; bits; bits &= bits - 1) {
+      int i = countr_zero(bits);
+      const char* c = p + i;
+
+      if (quotes >> i & 1) {
+        if (c == fieldStart) quoted = true;
+        inQuotes = !inQuotes;
+        continue;
+      }
+      if (inQuotes) continue;
+
+      bool isNewline = *c == '\n';
+      bool blankLine = isNewline && col == 0 && (c == fieldStart || (c == fieldStart + 1 && *fieldStart == '\r'));
+      if (!blankLine) {
+        endField(c, isNewline);
+        if (isNewline) endRow();
+      }
+      fieldStart = c + 1;
+      quoted = false;
+    }
+  }
+
+  if (fieldStart < chunk.end || col > 0) {
+    endField(chunk.end, true);
+    endRow();
+  }
+
+  table.rowCount = row;
+  for (auto& column : table.columns) ColumnResize(column, row);
+}
+
+// Parses again with the given columns read as text, for when numbers were
+// parsed from fields of what turned out to be a string column: formatting
+// them back would change their text.
+void ReparseCsvChunk(CsvChunk& chunk, char separator, vector<bool> keepText) {
+  chunk.table = {};
+  chunk.raggedRows = 0;
+  chunk.keepText = std::move(keepText);
+  chunk.promoted = false;
+  ParseCsvFields(chunk, separator);
+}
+
+bool ColumnHasValues(Column const& col) {
+  for (size_t i = 0; i < col.valid.count; ++i) {
+    if (col.valid[i]) return true;
+  }
+  return false;
+}
+
+void ParseCsvChunk(CsvChunk& chunk, char separator) {
+  ParseCsvFields(chunk, separator);
+  if (!chunk.promoted) return;
+
+  vector<bool> keepText(chunk.table.columns.size());
+  for (size_t c = 0; c < keepText.size(); ++c) keepText[c] = chunk.table.columns[c].type == Column_String;
+  ReparseCsvChunk(chunk, separator, std::move(keepText));
+}
+
+// Concatenates the chunk tables column by column, widening each column to
+// the widest type any chunk saw. Columns are independent so they merge in
+// parallel.
+Table MergeCsvChunks(vector<CsvChunk>& chunks) {
+  Table out = {};
+  size_t colCount = 0;
+  for (auto& chunk : chunks) {
+    out.rowCount += chunk.table.rowCount;
+    colCount = max(colCount, chunk.table.columns.size());
+  }
+  out.columns.resize(colCount);
+
+  ParallelFor(min(colCount, ThreadCount()), [&](size_t worker) {
+    for (size_t c = worker; c < colCount; c += ThreadCount()) {
+      Column& dst = out.columns[c];
+      dst.type = Column_Int64;
+      size_t charCount = 0;
+      for (auto& chunk : chunks) {
+        if (c >= chunk.table.columns.size()) continue;
+        dst.type = max(dst.type, chunk.table.columns[c].type);
+        charCount += chunk.table.columns[c].chars.count;
+      }
+      ColumnResize(dst, out.rowCount);
+      dst.chars.reserve(charCount);
+
+      size_t base = 0;
+      for (auto& chunk : chunks) {
+        size_t rowCount = chunk.table.rowCount;
+        if (c < chunk.table.columns.size()) {
+          Column& src = chunk.table.columns[c];
+          PromoteColumn(src, dst.type);
+          switch (dst.type) {
+            case Column_Int64 : memcpy(dst.ints.data + base, src.ints.data, rowCount*sizeof(int64_t)); break;
+            case Column_Double: memcpy(dst.doubles.data + base, src.doubles.data, rowCount*sizeof(double)); break;
+            case Column_String: {
+              size_t charBase = dst.chars.count;
+              dst.chars.resize(charBase + src.chars.count);
+              if (src.chars.count) memcpy(dst.chars.data + charBase, src.chars.data, src.chars.count);
+              for (size_t row = 0; row < rowCount; ++row) dst.offsets[base + row] = charBase + src.offsets[row];
+              memcpy(dst.lengths.data + base, src.lengths.data, rowCount*sizeof(uint32_t));
+            } break;
+          }
+          for (size_t row = 0; row < rowCount; ++row) {
+            if (!CellIsNull(src, row)) SetCellValid(dst, base + row, true);
+          }
+          src = {};
+        }
+        base += rowCount;
+      }
+    }
+  });
+
+  return out;
+}
+
+// Reads the first row as column names and returns where the data starts.
+const char* ParseCsvHeader(const char* begin, const char* end, vector<string>& names) {
+  if (begin == end) return begin;
+
+  CsvChunk header = { begin, NextRowStart(begin, end, false), {}, 0 };
+  ParseCsvChunk(header, ',');
+  ReparseCsvChunk(header, ',', vector<bool>(header.table.columns.size(), true));
+  char buffer[256];
+  for (auto const& col : header.table.columns) {
+    names.emplace_back(buffer, header.table.rowCount ? FormatCell(col, 0, buffer, sizeof(buffer)) : 0);
+  }
+  return header.end;
+}
+
+// Loads a CSV file by mapping it and parsing ranges of whole rows on every
+// core. Range boundaries are moved to the next newline outside of quotes;
+// whether a boundary starts inside quotes comes from the parity of the
+// quote count before it, which a first parallel pass computes.
+bool LoadCsv(const char* path, bool hasHeader, Table& table, char* status, size_t statusSize) {
+  constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  auto startTime = chrono::steady_clock::now();
+
+  MappedFile file = {};
+  if (!MapFile(path, file, status, statusSize)) return false;
+  madvise((void*)file.data, file.size, MADV_SEQUENTIAL);
+
+  const char* begin = file.data;
+  const char* end = file.data + file.size;
+
+  vector<string> names;
+  if (hasHeader) begin = ParseCsvHeader(begin, end, names);
+
+  size_t size = end - begin;
+  size_t chunkCount = max((size_t)1, min(ThreadCount(), size / MIN_CHUNK_SIZE));
+
+  vector<size_t> quoteCounts(chunkCount);
+  ParallelFor(chunkCount, [&](size_t i) {
+    quoteCounts[i] = CountQuotes(begin + size*i/chunkCount, begin + size*(i + 1)/chunkCount);
+  });
+
+  vector<CsvChunk> chunks(chunkCount);
+  size_t quotesBefore = 0;
+  const char* chunkStart = begin;
+  for (size_t i = 0; i < chunkCount; ++i) {
+    quotesBefore += quoteCounts[i];
+    const char* rawEnd = begin + size*(i + 1)/chunkCount;
+    const char* chunkEnd = i + 1 == chunkCount ? end : NextRowStart(rawEnd, end, quotesBefore % 2);
+    chunks[i].begin = chunkStart;
+    chunks[i].end = max(chunkStart, chunkEnd);
+    chunkStart = chunks[i].end;
+  }
+
+  ParallelFor(chunkCount, [&](size_t i) { ParseCsvChunk(chunks[i], ','); });
+
+  // A column that is text in one chunk is text in all of them; chunks that
+  // parsed numbers in it read it again.
+  vector<bool> keepText;
+  for (auto& chunk : chunks) {
+    keepText.resize(max(keepText.size(), chunk.table.columns.size()));
+    for (size_t c = 0; c < chunk.table.columns.size(); ++c) {
+      if (chunk.table.columns[c].type == Column_String) keepText[c] = true;
+    }
+  }
+  ParallelFor(chunkCount, [&](size_t i) {
+    Table const& table = chunks[i].table;
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+      if (keepText[c] && table.columns[c].type != Column_String && ColumnHasValues(table.columns[c])) {
+        ReparseCsvChunk(chunks[i], ',', keepText);
+        return;
+      }
+    }
+  });
+
+  size_t raggedRows = 0;
+  for (auto& chunk : chunks) raggedRows += chunk.raggedRows;
+
+  table = MergeCsvChunks(chunks);
+  for (size_t c = 0; c < names.size(); ++c) {
+    if (c >= table.columns.size()) TableAppendColumn(table);
+    table.columns[c].name = std::move(names[c]);
+  }
+  TableShrinkToFit(table);
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Loaded %zu rows x %zu cols in %.3f s (%.0f MB/s, %zu ragged rows)",
+           table.rowCount, table.columns.size(), seconds, (double)file.size / 1e6 / max(seconds, 1e-9), raggedRows);
+  UnmapFile(file);
+  return true;
+}
+
+// Returns room for n more bytes at the end of out; the caller bumps count.
+char* ReserveBytes(Array<char>& out, size_t n) {
+  if (out.count + n > out.capacity) out.reserve(max(out.count + n, out.capacity*2));
+  return out.data + out.count;
+}
+
+void AppendBytes(Array<char>& out, string_view bytes) {
+  memcpy(ReserveBytes(out, bytes.size()), bytes.data(), bytes.size());
+  out.count += bytes.size();
+}
+
+// Strings are quoted whenever their bare text would load as something
+// else: empty text loads as null, numeric text as a number.
+bool CsvNeedsQuotes(string_view s) {
+  if (s.empty() || s.find_first_of(",\"\r\n") != string_view::npos) return true;
+  double d = 0.0;
+  auto [ptr, ec] = from_chars(s.data(), s.data() + s.size(), d);
+  return ec == errc() && ptr == s.data() + s.size();
+}
+
+void AppendCsvString(Array<char>& out, string_view s) {
+  if (!CsvNeedsQuotes(s)) {
+    AppendBytes(out, s);
+    return;
+  }
+
+  char* p = ReserveBytes(out, 2*s.size() + 2);
+  *p++ = '"';
+  for (char c : s) {
+    if (c == '"') *p++ = '"';
+    *p++ = c;
+  }
+  *p++ = '"';
+  out.count = p - out.data;
+}
+
+// Numbers are written as the shortest text that parses back to the same
+// value, which %f didn't do. Integral doubles keep a ".0" so their column
+// loads as double again.
+// Formula cells are written as their formula text, not their value.
+// A row ending in a null gets one more separator, since the parser drops a
+// single trailing one; otherwise a null last column would vanish and a
+// null in a one column table would be a skipped blank line.
+void FormatCsvRows(Table const& table, FormulaSheet const* formulas, size_t rowBegin, size_t rowEnd, Array<char>& out) {
+  out.count = 0;
+  for (size_t row = rowBegin; row < rowEnd; ++row) {
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+      Column const& col = table.columns[c];
+      if (c > 0) out.push_back(',');
+      if (formulas && c < formulas->columnCounts.size() && formulas->columnCounts[c]) {
+        if (auto it = formulas->byCell.find(CellKey(row, c)); it != formulas->byCell.end()) {
+          AppendCsvString(out, formulas->formulas[it->second].text);
+          continue;
+        }
+      }
+      if (CellIsNull(col, row)) {
+        if (c + 1 == table.columns.size()) out.push_back(',');
+        continue;
+      }
+
+      switch (col.type) {
+        case Column_Int64: {
+          char* p = ReserveBytes(out, 24);
+          out.count = to_chars(p, p + 24, col.ints[row]).ptr - out.data;
+        } break;
+        case Column_Double: {
+          char* p = ReserveBytes(out, 34);
+          char* end = to_chars(p, p + 32, col.doubles[row]).ptr;
+          if (string_view(p, end - p).find_first_of(".en") == string_view::npos) {
+            *end++ = '.';
+            *end++ = '0';
+          }
+          out.count = end - out.data;
+        } break;
+        case Column_String: {
+          AppendCsvString(out, CellString(col, row));
+        } break;
+      }
+    }
+    out.push_back('\n');
+  }
+}
+
+bool WriteAll(int fd, iovec* iov, int iovCount) {
+  while (iovCount > 0) {
+    ssize_t n = writev(fd, iov, iovCount);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) return false;
+
+    while (iovCount > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      ++iov;
+      --iovCount;
+    }
+    if (iovCount > 0) {
+      iov->iov_base = (char*)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  return true;
+}
+
+// Saves go to a temporary file next to the destination that is renamed over
+// it once complete, so a failed save never leaves a truncated file behind.
+int CreateTempFile(const char* path, string& tempPath, char* status, size_t statusSize) {
+  tempPath = string(path) + ".XXXXXX";
+  int fd = mkstemp(tempPath.data());
+  if (fd == -1) {
+    snprintf(status, statusSize, "mkstemp %s: %s", tempPath.c_str(), strerror(errno));
+    return -1;
+  }
+  fchmod(fd, 0644);
+  return fd;
+}
+
+bool CommitTempFile(int fd, string const& tempPath, const char* path, bool ok, char* status, size_t statusSize) {
+  if (!ok || fsync(fd) == -1) {
+    snprintf(status, statusSize, "write %s: %s", tempPath.c_str(), strerror(errno));
+    close(fd);
+    unlink(tempPath.c_str());
+    return false;
+  }
+  close(fd);
+
+  if (rename(tempPath.c_str(), path) == -1) {
+    snprintf(status, statusSize, "rename %s: %s", path, strerror(errno));
+    unlink(tempPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Formats batches of chunks in parallel into reusable buffers, with
+// formatChunk(i, out) producing the text of chunk i, and flushes each batch
+// with a single writev.
+template <typename F>
+bool WriteCsvFile(const char* path, vector<string> const* header, size_t chunkTotal, F const& formatChunk, char* status, size_t statusSize) {
+  string tempPath;
+  int fd = CreateTempFile(path, tempPath, status, statusSize);
+  if (fd == -1) return false;
+
+  size_t batchSize = min(ThreadCount(), (size_t)IOV_MAX);
+  vector<Array<char>> buffers(batchSize);
+  vector<iovec> iov(batchSize);
+
+  bool ok = true;
+  if (header) {
+    for (size_t c = 0; c < header->size(); ++c) {
+      if (c > 0) AppendBytes(buffers[0], ",");
+      AppendCsvString(buffers[0], (*header)[c]);
+    }
+    AppendBytes(buffers[0], "\n");
+    iov[0] = { buffers[0].data, buffers[0].count };
+    ok = WriteAll(fd, iov.data(), 1);
+  }
+
+  for (size_t batchBegin = 0; ok && batchBegin < chunkTotal; batchBegin += batchSize) {
+    size_t count = min(batchSize, chunkTotal - batchBegin);
+    ParallelFor(count, [&](size_t i) {
+      buffers[i].count = 0;
+      formatChunk(batchBegin + i, buffers[i]);
+    });
+
+    for (size_t i = 0; i < count; ++i) iov[i] = { buffers[i].data, buffers[i].count };
+    ok = WriteAll(fd, iov.data(), count);
+  }
+
+  return CommitTempFile(fd, tempPath, path, ok, status, statusSize);
+}
+
+bool SaveCsv(const char* path, bool hasHeader, Table const& table, FormulaSheet const& formulas, char* status, size_t statusSize) {
+  constexpr size_t CHUNK_BYTES = 4 << 20;
+
+  auto startTime = chrono::steady_clock::now();
+
+  vector<string> names;
+  for (auto const& col : table.columns) names.push_back(col.name);
+
+  size_t rowsPerChunk = max((size_t)1, CHUNK_BYTES / (8*max((size_t)1, table.columns.size())));
+  size_t chunkTotal = (table.rowCount + rowsPerChunk - 1) / rowsPerChunk;
+  bool ok = WriteCsvFile(path, hasHeader ? &names : nullptr, chunkTotal, [&](size_t chunk, Array<char>& out) {
+    size_t rowBegin = chunk*rowsPerChunk;
+    FormatCsvRows(table, &formulas, rowBegin, min(table.rowCount, rowBegin + rowsPerChunk), out);
+  }, status, statusSize);
+  if (!ok) return false;
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Saved %zu rows x %zu cols in %.3f s", table.rowCount, table.columns.size(), seconds);
+  return true;
+}
+
+constexpr size_t STREAM_BLOCK_ROWS = 4096;
+constexpr size_t STREAM_CACHE_BLOCKS = 64;
+
+struct StreamBlock {
+  size_t index;
+  uint64_t lastUse;
+  Table table;
+};
+
+// A CSV file browsed without loading it. One pass records the byte offset
+// of every STREAM_BLOCK_ROWS-th row; blocks of rows are then parsed from
+// the mapping as they scroll into view and kept in a small LRU. Edits stay
+// in an overlay, keyed by (row, col), until the file is saved.
+struct CsvStream {
+  MappedFile file;
+  vector<uint64_t> blockOffsets;  // one per block, plus the end of the file
+  size_t rowCount;
+  size_t colCount;
+  vector<string> names;
+
+  vector<StreamBlock> cache;
+  uint64_t useCounter;
+
+  map<pair<uint64_t, uint32_t>, string> edits;
+
+  ~CsvStream() { UnmapFile(file); }
+};
+
+Table const& GetStreamBlock(CsvStream& stream, size_t index) {
+  ++stream.useCounter;
+  for (auto& block : stream.cache) {
+    if (block.index == index) {
+      block.lastUse = stream.useCounter;
+      return block.table;
+    }
+  }
+
+  StreamBlock* slot = nullptr;
+  if (stream.cache.size() < STREAM_CACHE_BLOCKS) {
+    slot = &stream.cache.emplace_back();
+  } else {
+    slot = &*min_element(stream.cache.begin(), stream.cache.end(), [](StreamBlock const& a, StreamBlock const& b) { return a.lastUse < b.lastUse; });
+  }
+
+  CsvChunk chunk = { stream.file.data + stream.blockOffsets[index], stream.file.data + stream.blockOffsets[index + 1], {}, 0 };
+  ParseCsvChunk(chunk, ',');
+  stream.colCount = max(stream.colCount, chunk.table.columns.size());
+
+  slot->index = index;
+  slot->lastUse = stream.useCounter;
+  slot->table = std::move(chunk.table);
+  return slot->table;
+}
+
+bool OpenCsvStream(const char* path, bool hasHeader, CsvStream& stream, char* status, size_t statusSize) {
+  auto startTime = chrono::steady_clock::now();
+
+  if (!MapFile(path, stream.file, status, statusSize)) return false;
+  const char* data = stream.file.data;
+  const char* begin = data;
+  const char* end = data + stream.file.size;
+  madvise((void*)data, stream.file.size, MADV_SEQUENTIAL);
+
+  if (hasHeader) begin = ParseCsvHeader(begin, end, stream.names);
+
+  // Same row rules as ParseCsvChunk: newlines inside quotes don't end a
+  // row and blank lines aren't rows.
+  stream.blockOffsets.push_back(begin - data);
+  size_t rowCount = 0;
+  bool inQuotes = false;
+  const char* lineStart = begin;
+  char padded[16];
+  for (const char* p = begin; p < end; p += 16) {
+    const char* block = p;
+    if (end - p < 16) {
+      memset(padded, 0, sizeof(padded));
+      memcpy(padded, p, end - p);
+      block = padded;
+    }
+
+    uint32_t quotes, newlines;
+    ScanBlock(block, '\n', quotes, newlines);
+    for (uint32_t bits = quotes | newlines; bits; bits &= bits - 1) {
+      int i = countr_zero(bits);
+      const char* c = p + i;
+      if (quotes >> i & 1) {
+        inQuotes = !inQuotes;
+        continue;
+      }
+      if (inQuotes) continue;
+
+      bool blankLine = c == lineStart || (c == lineStart + 1 && *lineStart == '\r');
+      if (!blankLine && ++rowCount % STREAM_BLOCK_ROWS == 0) {
+        stream.blockOffsets.push_back(c + 1 - data);
+      }
+      lineStart = c + 1;
+    }
+  }
+  if (lineStart < end && !(lineStart + 1 == end && *lineStart == '\r')) ++rowCount;
+  if (stream.blockOffsets.back() != stream.file.size) stream.blockOffsets.push_back(stream.file.size);
+
+  madvise((void*)data, stream.file.size, MADV_RANDOM);
+  stream.rowCount = rowCount;
+  stream.colCount = stream.names.size();
+
+  // Without a header nothing tells the column count until a block is
+  // parsed, and the table isn't drawn while it is 0.
+  if (rowCount > 0) GetStreamBlock(stream, 0);
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Indexed %zu rows in %.3f s, streaming from %s", rowCount, seconds, path);
+  return true;
+}
+
+int FormatStreamCell(CsvStream& stream, size_t row, size_t col, char* buffer, size_t size) {
+  if (auto it = stream.edits.find({ row, col }); it != stream.edits.end()) {
+    size_t n = min(it->second.size(), size);
+    memcpy(buffer, it->second.data(), n);
+    return n;
+  }
+
+  Table const& block = GetStreamBlock(stream, row / STREAM_BLOCK_ROWS);
+  size_t blockRow = row % STREAM_BLOCK_ROWS;
+  if (col >= block.columns.size() || blockRow >= block.rowCount) return 0;
+  return FormatCell(block.columns[col], blockRow, buffer, size);
+}
+
+// Re-parses the mapped file block by block, applies the edit overlay and
+// writes the result, so saving needs no more memory than a batch of blocks.
+bool SaveCsvStream(const char* path, bool hasHeader, CsvStream& stream, char* status, size_t statusSize) {
+  auto startTime = chrono::steady_clock::now();
+
+  size_t blockCount = stream.blockOffsets.size() - 1;
+  bool ok = WriteCsvFile(path, hasHeader ? &stream.names : nullptr, blockCount, [&](size_t index, Array<char>& out) {
+    CsvChunk chunk = { stream.file.data + stream.blockOffsets[index], stream.file.data + stream.blockOffsets[index + 1], {}, 0 };
+    ParseCsvChunk(chunk, ',');
+    Table& table = chunk.table;
+    if (table.columns.size() < stream.colCount) TableResize(table, table.rowCount, stream.colCount);
+
+    uint64_t base = index*STREAM_BLOCK_ROWS;
+    for (auto it = stream.edits.lower_bound({ base, 0 }); it != stream.edits.end() && it->first.first < base + table.rowCount; ++it) {
+      SetCellFromText(table.columns[it->first.second], it->first.first - base, it->second);
+    }
+    FormatCsvRows(table, nullptr, 0, table.rowCount, out);
+  }, status, statusSize);
+  if (!ok) return false;
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Saved %zu rows x %zu cols in %.3f s", stream.rowCount, stream.colCount, seconds);
+  return true;
+}
+
+size_t ViewRowCount(App& app) {
+  if (app.stream) return app.stream->rowCount;
+  return app.viewActive ? app.viewRows.size() : app.table.rowCount;
+}
+
+// Maps a displayed row to its table row through the current filter/sort.
+size_t ViewRow(App& app, size_t row) {
+  return app.viewActive ? app.viewRows[row] : row;
+}
+
+size_t ViewColCount(App& app) {
+  return app.stream ? app.stream->colCount : app.table.columns.size();
+}
+
+string_view ViewColumnName(App& app, size_t col) {
+  if (app.stream) return col < app.stream->names.size() ? app.stream->names[col] : string_view();
+  return app.table.columns[col].name;
+}
+
+Formula const* CellFormula(FormulaSheet const& sheet, size_t row, size_t col) {
+  if (col >= sheet.columnCounts.size() || !sheet.columnCounts[col]) return nullptr;
+  auto it = sheet.byCell.find(CellKey(row, col));
+  return it == sheet.byCell.end() ? nullptr : &sheet.formulas[it->second];
+}
+
+// Failed formulas leave their cell null and show their error instead, as
+// do results held by the formula.
+int FormatViewCell(App& app, size_t row, size_t col, char* buffer, size_t size) {
+  if (app.stream) return FormatStreamCell(*app.stream, row, col, buffer, size);
+
+  int n = FormatCell(app.table.columns[col], row, buffer, size);
+  if (n > 0) return n;
+  if (Formula const* formula = CellFormula(app.formulas, row, col)) {
+    if (formula->error) {
+      n = min(strlen(formula->error), size);
+      memcpy(buffer, formula->error, n);
+    } else if (formula->held) {
+      n = to_chars(buffer, buffer + size, formula->value).ptr - buffer;
+    }
+  }
+  return n;
+}
+
+// What the edit popup starts with: the formula of formula cells.
+int FormatEditText(App& app, size_t row, size_t col, char* buffer, size_t size) {
+  if (!app.stream) {
+    if (auto it = app.formulas.byCell.find(CellKey(row, col)); it != app.formulas.byCell.end()) {
+      string const& text = app.formulas.formulas[it->second].text;
+      size_t n = min(text.size(), size);
+      memcpy(buffer, text.data(), n);
+      return n;
+    }
+  }
+  return FormatViewCell(app, row, col, buffer, size);
+}
+
+void InvalidateCellCache(App& app) {
+  if (app.cellCache.empty()) app.cellCache.resize(CELL_CACHE_SIZE);
+  for (auto& entry : app.cellCache) entry.row = UINT64_MAX;
+}
+
+CellCacheEntry& CellCacheSlot(App& app, size_t row, size_t col) {
+  uint64_t hash = (row*0x9E3779B97F4A7C15ull) ^ (col*0xC2B2AE3D27D4EB4Full);
+  return app.cellCache[(hash >> 32) % CELL_CACHE_SIZE];
+}
+
+string_view CachedCellText(App& app, size_t row, size_t col) {
+  CellCacheEntry& entry = CellCacheSlot(app, row, col);
+  if (entry.row != row || entry.col != col) {
+    entry.row = row;
+    entry.col = col;
+    entry.length = FormatViewCell(app, row, col, entry.text, sizeof(entry.text));
+  }
+  return string_view(entry.text, entry.length);
+}
+
+// Excel-style column name: A..Z, AA..AZ, BA.. and so on.
+int ColumnLetters(size_t index, char* out) {
+  char reversed[16];
+  int n = 0;
+  for (size_t i = index + 1; i > 0; i = (i - 1) / 26) {
+    reversed[n++] = 'A' + (i - 1) % 26;
+  }
+  for (int i = 0; i < n; ++i) out[i] = reversed[n - 1 - i];
+  out[n] = 0;
+  return n;
+}
+
+struct Moments {
+  size_t count;
+  double sum, min, max;
+  double mean, m2;
+};
+
+// Count, sum, min, max, mean and squared deviations over rows [begin, end)
+// of a numeric column. begin must be a multiple of 64 so validity words are
+// whole. Words with all 64 rows valid go through SSE2 for double columns,
+// two lanes times two accumulators; the rest takes the scalar path.
+template <typename T>
+Moments ReduceMoments(const T* values, const uint64_t* valid, size_t begin, size_t end) {
+  Moments m = { 0, 0.0, INFINITY, -INFINITY, 0.0, 0.0 };
+
+#ifdef __SSE2__
+  constexpr bool useSimd = is_same_v<T, double>;
+  __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+  __m128d min0 = _mm_set1_pd(INFINITY), min1 = min0;
+  __m128d max0 = _mm_set1_pd(-INFINITY), max1 = max0;
+#else
+  constexpr bool useSimd = false;
+#endif
+
+  for (size_t base = begin; base < end; base += 64) {
+    uint64_t word = valid[base / 64];
+    if (end - base < 64) word &= ((uint64_t)1 << (end - base)) - 1;
+
+#ifdef __SSE2__
+    if (useSimd && word == ~(uint64_t)0) {
+      const double* p = (const double*)values + base;
+      for (size_t i = 0; i < 64; i += 4) {
+        __m128d a = _mm_loadu_pd(p + i), b = _mm_loadu_pd(p + i + 2);
+        sum0 = _mm_add_pd(sum0, a); sum1 = _mm_add_pd(sum1, b);
+        min0 = _mm_min_pd(min0, a); min1 = _mm_min_pd(min1, b);
+        max0 = _mm_max_pd(max0, a); max1 = _mm_max_pd(max1, b);
+      }
+      m.count += 64;
+      continue;
+    }
+#endif
+
+    for (; word; word &= word - 1) {
+      double x = (double)values[base + countr_zero(word)];
+      m.sum += x;
+      m.min = min(m.min, x);
+      m.max = max(m.max, x);
+      ++m.count;
+    }
+  }
+
+#ifdef __SSE2__
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+  m.sum += lanes[0] + lanes[1];
+  _mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+  m.min = min(m.min, min(lanes[0], lanes[1]));
+  _mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+  m.max = max(m.max, max(lanes[0], lanes[1]));
+#endif
+
+  if (m.count == 0) return m;
+  m.mean = m.sum / m.count;
+
+  // Second pass around this chunk's mean, which keeps the variance exact
+  // where a single sum of squares would cancel.
+#ifdef __SSE2__
+  __m128d mean = _mm_set1_pd(m.mean);
+  __m128d sq0 = _mm_setzero_pd(), sq1 = _mm_setzero_pd();
+#endif
+  for (size_t base = begin; base < end; base += 64) {
+    uint64_t word = valid[base / 64];
+    if (end - base < 64) word &= ((uint64_t)1 << (end - base)) - 1;
+
+#ifdef __SSE2__
+    if (useSimd && word == ~(uint64_t)0) {
+      const double* p = (const double*)values + base;
+      for (size_t i = 0; i < 64; i += 4) {
+        __m128d a = _mm_sub_pd(_mm_loadu_pd(p + i), mean), b = _mm_sub_pd(_mm_loadu_pd(p + i + 2), mean);
+        sq0 = _mm_add_pd(sq0, _mm_mul_pd(a, a));
+        sq1 = _mm_add_pd(sq1, _mm_mul_pd(b, b));
+      }
+      continue;
+    }
+#endif
+
+    for (; word; word &= word - 1) {
+      double d = (double)values[base + countr_zero(word)] - m.mean;
+      m.m2 += d*d;
+    }
+  }
+#ifdef __SSE2__
+  _mm_storeu_pd(lanes, _mm_add_pd(sq0, sq1));
+  m.m2 += lanes[0] + lanes[1];
+#endif
+
+  return m;
+}
+
+// Chan et al. pairwise combination of two partial results.
+Moments CombineMoments(Moments a, Moments const& b) {
+  if (b.count == 0) return a;
+  if (a.count == 0) return b;
+
+  size_t n = a.count + b.count;
+  double delta = b.mean - a.mean;
+  a.m2 += b.m2 + delta*delta*((double)a.count*(double)b.count/(double)n);
+  a.mean += delta*((double)b.count/(double)n);
+  a.count = n;
+  a.sum += b.sum;
+  a.min = min(a.min, b.min);
+  a.max = max(a.max, b.max);
+  return a;
+}
+
+// Splits rows into one range per thread, each a multiple of 64 rows.
+size_t RowChunkCount(size_t rowCount) {
+  return max((size_t)1, min(ThreadCount(), rowCount / 4096));
+}
+
+size_t RowChunkBegin(size_t rowCount, size_t chunk, size_t chunkCount) {
+  return chunk == chunkCount ? rowCount : (rowCount*chunk/chunkCount) & ~(size_t)63;
+}
+
+ColumnStats ComputeColumnStats(Column const& col, size_t rowCount) {
+  ColumnStats stats = {};
+  stats.numeric = col.type != Column_String;
+  if (!stats.numeric) return stats;
+
+  size_t chunkCount = RowChunkCount(rowCount);
+  vector<Moments> partials(chunkCount);
+  vector<vector<double>> sortedChunks(chunkCount);
+  ParallelFor(chunkCount, [&](size_t i) {
+    size_t begin = RowChunkBegin(rowCount, i, chunkCount);
+    size_t end = RowChunkBegin(rowCount, i + 1, chunkCount);
+    partials[i] = col.type == Column_Int64 ? ReduceMoments(col.ints.data, col.valid.data, begin, end)
+                                           : ReduceMoments(col.doubles.data, col.valid.data, begin, end);
+
+    auto& values = sortedChunks[i];
+    values.reserve(partials[i].count);
+    // NaNs have no place in a sorted order, so like nulls they are left out.
+    for (size_t row = begin; row < end; ++row) {
+      double value = CellAsDouble(col, row);
+      if (!isnan(value)) values.push_back(value);
+    }
+    sort(values.begin(), values.end());
+  });
+
+  Moments total = {};
+  for (auto const& partial : partials) total = CombineMoments(total, partial);
+  stats.count = total.count;
+  stats.sum = total.sum;
+  stats.mean = total.mean;
+  stats.m2 = total.m2;
+
+  // Merge the sorted chunks pairwise, each round in parallel.
+  vector<size_t> bounds = { 0 };
+  stats.sorted.reserve(total.count);
+  for (auto& values : sortedChunks) {
+    stats.sorted.insert(stats.sorted.end(), values.begin(), values.end());
+    bounds.push_back(stats.sorted.size());
+    values = {};
+  }
+  for (size_t width = 1; width < chunkCount; width *= 2) {
+    size_t pairCount = (chunkCount + 2*width - 1) / (2*width);
+    ParallelFor(pairCount, [&](size_t pair) {
+      size_t first = pair*2*width;
+      size_t middle = min(first + width, chunkCount);
+      size_t last = min(first + 2*width, chunkCount);
+      inplace_merge(stats.sorted.begin() + bounds[first], stats.sorted.begin() + bounds[middle], stats.sorted.begin() + bounds[last]);
+    });
+  }
+
+  // The moments counted NaN cells as values; redo them without.
+  if (stats.sorted.size() != stats.count) {
+    stats.count = stats.sorted.size();
+    stats.sum = accumulate(stats.sorted.begin(), stats.sorted.end(), 0.0);
+    stats.mean = stats.count ? stats.sum / stats.count : 0.0;
+    stats.m2 = 0.0;
+    for (double value : stats.sorted) stats.m2 += (value - stats.mean)*(value - stats.mean);
+  }
+
+  return stats;
+}
+
+// Folds a single cell edit into the stats: Welford's update for the mean
+// and squared deviations, one erase and one insert for the sorted values.
+// Returns false, leaving the stats alone, when the old value isn't in them.
+bool UpdateColumnStats(ColumnStats& stats, double oldValue, double newValue) {
+  if (!isnan(oldValue)) {
+    auto it = lower_bound(stats.sorted.begin(), stats.sorted.end(), oldValue);
+    if (it == stats.sorted.end() || *it != oldValue) return false;
+    stats.sorted.erase(it);
+    --stats.count;
+    stats.sum -= oldValue;
+    if (stats.count == 0) {
+      stats.mean = stats.m2 = 0.0;
+    } else {
+      double oldMean = stats.mean;
+      stats.mean -= (oldValue - stats.mean) / stats.count;
+      stats.m2 -= (oldValue - oldMean)*(oldValue - stats.mean);
+      stats.m2 = max(stats.m2, 0.0);
+    }
+  }
+
+  if (!isnan(newValue)) {
+    stats.sorted.insert(upper_bound(stats.sorted.begin(), stats.sorted.end(), newValue), newValue);
+    ++stats.count;
+    stats.sum += newValue;
+    double delta = newValue - stats.mean;
+    stats.mean += delta / stats.count;
+    stats.m2 += delta*(newValue - stats.mean);
+  }
+  return true;
+}
+
+double Quantile(vector<double> const& sorted, double q) {
+  if (sorted.empty()) return NAN;
+  double position = q*(sorted.size() - 1);
+  size_t i = (size_t)position;
+  if (i + 1 >= sorted.size()) return sorted.back();
+  return sorted[i] + (position - i)*(sorted[i + 1] - sorted[i]);
+}
+
+ColumnSummary SummarizeColumn(ColumnStats const& stats) {
+  ColumnSummary summary = {};
+  summary.numeric = stats.numeric;
+  summary.count = stats.count;
+  summary.sum = stats.sum;
+  summary.mean = stats.mean;
+  summary.stddev = stats.count > 1 ? sqrt(stats.m2 / (stats.count - 1)) : 0.0;
+  summary.min = stats.sorted.empty() ? NAN : stats.sorted.front();
+  summary.max = stats.sorted.empty() ? NAN : stats.sorted.back();
+  for (size_t i = 0; i < size(STATS_QUANTILES); ++i) summary.quantiles[i] = Quantile(stats.sorted, STATS_QUANTILES[i]);
+  return summary;
+}
+
+// Aggregates valueCol grouped by the distinct values of keyCol. Each row
+// range builds its own hash map, the maps are merged at the end.
+vector<GroupRow> GroupBy(Table const& table, size_t keyCol, size_t valueCol) {
+  Column const& keys = table.columns[keyCol];
+  Column const& values = table.columns[valueCol];
+
+  size_t chunkCount = RowChunkCount(table.rowCount);
+  vector<unordered_map<string_view, GroupRow>> partials(chunkCount);
+  vector<Array<char>> keyText(chunkCount);
+  ParallelFor(chunkCount, [&](size_t i) {
+    size_t begin = RowChunkBegin(table.rowCount, i, chunkCount);
+    size_t end = RowChunkBegin(table.rowCount, i + 1, chunkCount);
+
+    // Number keys are formatted once per row into this chunk's arena so all
+    // key types share one map. Two passes: fill the arena, then hash views.
+    vector<uint64_t> keyOffsets(end - begin + 1);
+    auto& arena = keyText[i];
+    if (keys.type != Column_String) {
+      for (size_t row = begin; row < end; ++row) {
+        keyOffsets[row - begin] = arena.count;
+        char buffer[32];
+        AppendBytes(arena, string_view(buffer, FormatCell(keys, row, buffer, sizeof(buffer))));
+      }
+      keyOffsets[end - begin] = arena.count;
+    }
+
+    auto& groups = partials[i];
+    for (size_t row = begin; row < end; ++row) {
+      string_view key = keys.type == Column_String
+        ? (CellIsNull(keys, row) ? string_view() : CellString(keys, row))
+        : string_view(arena.data + keyOffsets[row - begin], keyOffsets[row - begin + 1] - keyOffsets[row - begin]);
+
+      auto [it, inserted] = groups.try_emplace(key);
+      GroupRow& group = it->second;
+      if (inserted) group = { {}, 0, 0, 0.0, INFINITY, -INFINITY };
+      ++group.rows;
+
+      double value = CellAsDouble(values, row);
+      if (isnan(value)) continue;
+      ++group.count;
+      group.sum += value;
+      group.min = min(group.min, value);
+      group.max = max(group.max, value);
+    }
+  });
+
+  unordered_map<string_view, GroupRow> merged;
+  for (auto& groups : partials) {
+    for (auto& [key, group] : groups) {
+      auto [it, inserted] = merged.try_emplace(key, group);
+      if (inserted) continue;
+      GroupRow& into = it->second;
+      into.rows += group.rows;
+      into.count += group.count;
+      into.sum += group.sum;
+      into.min = min(into.min, group.min);
+      into.max = max(into.max, group.max);
+    }
+  }
+
+  vector<GroupRow> out;
+  out.reserve(merged.size());
+  for (auto& [key, group] : merged) {
+    out.push_back(group);
+    out.back().key = key.empty() ? "(null)" : string(key);
+  }
+  sort(out.begin(), out.end(), [](GroupRow const& a, GroupRow const& b) { return a.rows > b.rows; });
+  return out;
+}
+
+// Each folded cell moves up to a column's worth of sorted values, so past a
+// few dozen cells a rescan is cheaper.
+constexpr size_t STATS_UPDATE_LIMIT = 32;
+
+// Runs on the query worker. Rescans every column, or folds changed cells
+// into the kept stats; a column whose fold doesn't match is rescanned.
+void UpdateWorkerStats(QueryWorker& q, Table const& table, bool rescan, vector<CellChange> const& changes) {
+  if (rescan || changes.size() > STATS_UPDATE_LIMIT || q.stats.size() != table.columns.size()) {
+    q.stats.resize(table.columns.size());
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+      q.stats[c] = ComputeColumnStats(table.columns[c], table.rowCount);
+    }
+    return;
+  }
+
+  for (auto const& change : changes) {
+    Column const& col = table.columns[change.col];
+    ColumnStats& stats = q.stats[change.col];
+    if (col.type == Column_String) stats = {};
+    else if (!stats.numeric || !UpdateColumnStats(stats, change.oldValue, change.newValue)) stats = ComputeColumnStats(col, table.rowCount);
+  }
+}
+
+// Forgets the stats of the old table along with any request in flight.
+void InvalidateStats(App& app) {
+  app.statsActive = false;
+  app.stats.clear();
+  app.statsResetAt = app.query->statsRequested;
+  app.groups.clear();
+}
+
+// Asks the worker to rescan every column, or to fold changes in.
+void RequestStats(App& app, bool rescan, vector<CellChange> const& changes) {
+  QueryWorker& q = *app.query;
+  lock_guard l(q.lock);
+  q.statsTable = &app.table;
+  if (rescan) {
+    q.statsRescan = true;
+    q.statsChanges.clear();
+  } else {
+    q.statsChanges.insert(q.statsChanges.end(), changes.begin(), changes.end());
+  }
+  ++q.statsRequested;
+  q.wakeup.notify_one();
+}
+
+// Folds cells changed by an edit or a recalculation into the stats.
+void UpdateStatsForChanges(App& app, vector<CellChange> const& changes) {
+  app.groups.clear();
+  if (app.statsActive && !changes.empty()) RequestStats(app, false, changes);
+}
+
+// Picks up the worker's latest summaries, if any.
+void PollStats(App& app) {
+  QueryWorker& q = *app.query;
+  if (q.statsFinished == app.statsGeneration) return;
+
+  lock_guard l(q.lock);
+  app.statsGeneration = q.statsFinished;
+  if (q.statsFinished <= app.statsResetAt) return;
+  app.stats = q.summaries;
+}
+
+struct FilterParser {
+  const char* begin;
+  const char* p;
+  const char* end;
+  Table const* table;
+  FilterPlan* plan;
+  size_t depth;
+  char error[128];
+};
+
+bool FilterError(FilterParser& parser, const char* message) {
+  snprintf(parser.error, sizeof(parser.error), "%s at column %zu", message, parser.p - parser.begin + 1);
+  return false;
+}
+
+// Skips spaces, then consumes token if it comes next.
+bool AcceptToken(const char*& p, const char* end, string_view token) {
+  while (p < end && isspace((unsigned char)*p)) ++p;
+  if ((size_t)(end - p) < token.size() || string_view(p, token.size()) != token) return false;
+  p += token.size();
+  return true;
+}
+
+void EmitFilterOp(FilterParser& parser, FilterOp op) {
+  if (op.kind == Filter_Compare) parser.plan->stackDepth = max(parser.plan->stackDepth, ++parser.depth);
+  if (op.kind == Filter_And || op.kind == Filter_Or) --parser.depth;
+  parser.plan->ops.push_back(std::move(op));
+}
+
+// A column is named by its header or by its letters (A, B, ..., AA).
+bool ParseFilterColumn(FilterParser& parser, uint32_t& col) {
+  AcceptToken(parser.p, parser.end, "");
+  const char* begin = parser.p;
+  while (parser.p < parser.end && (isalnum((unsigned char)*parser.p) || *parser.p == '_')) ++parser.p;
+  string_view name(begin, parser.p - begin);
+  if (name.empty()) return FilterError(parser, "expected a column");
+
+  auto const& columns = parser.table->columns;
+  for (size_t i = 0; i < columns.size(); ++i) {
+    if (columns[i].name == name) {
+      col = i;
+      return true;
+    }
+  }
+
+  size_t index = 0;
+  for (char c : name) {
+    if (!isalpha((unsigned char)c)) return FilterError(parser, "unknown column");
+    index = index*26 + (toupper(c) - 'A' + 1);
+  }
+  if (index - 1 >= columns.size()) return FilterError(parser, "unknown column");
+  col = index - 1;
+  return true;
+}
+
+bool ParseFilterOr(FilterParser& parser);
+
+bool ParseFilterUnary(FilterParser& parser) {
+  if (AcceptToken(parser.p, parser.end, "!")) {
+    if (!ParseFilterUnary(parser)) return false;
+    EmitFilterOp(parser, { Filter_Not });
+    return true;
+  }
+  if (AcceptToken(parser.p, parser.end, "(")) {
+    if (!ParseFilterOr(parser)) return false;
+    if (!AcceptToken(parser.p, parser.end, ")")) return FilterError(parser, "expected )");
+    return true;
+  }
+
+  FilterOp op = { Filter_Compare };
+  if (!ParseFilterColumn(parser, op.col)) return false;
+
+  static const pair<string_view, CompareOp> compareOps[] = {
+    { "==", Compare_Eq }, { "!=", Compare_Ne }, { "<=", Compare_Le }, { ">=", Compare_Ge },
+    { "<", Compare_Lt }, { ">", Compare_Gt }, { "=", Compare_Eq },
+  };
+  bool found = false;
+  for (auto [token, compare] : compareOps) {
+    if (AcceptToken(parser.p, parser.end, token)) {
+      op.compare = compare;
+      found = true;
+      break;
+    }
+  }
+  if (!found) return FilterError(parser, "expected a comparison");
+
+  if (AcceptToken(parser.p, parser.end, "\"")) {
+    const char* begin = parser.p;
+    while (parser.p < parser.end && *parser.p != '"') ++parser.p;
+    if (parser.p == parser.end) return FilterError(parser, "unterminated string");
+    op.isText = true;
+    op.text.assign(begin, parser.p++);
+  } else {
+    AcceptToken(parser.p, parser.end, "");
+    auto [ptr, ec] = from_chars(parser.p, parser.end, op.number);
+    if (ec != errc()) return FilterError(parser, "expected a number or a quoted string");
+    parser.p = ptr;
+  }
+
+  if (op.isText != (parser.table->columns[op.col].type == Column_String)) {
+    return FilterError(parser, op.isText ? "text compared with a number column" : "number compared with a text column");
+  }
+  EmitFilterOp(parser, std::move(op));
+  return true;
+}
+
+bool ParseFilterAnd(FilterParser& parser) {
+  if (!ParseFilterUnary(parser)) return false;
+  while (AcceptToken(parser.p, parser.end, "&&")) {
+    if (!ParseFilterUnary(parser)) return false;
+    EmitFilterOp(parser, { Filter_And });
+  }
+  return true;
+}
+
+bool ParseFilterOr(FilterParser& parser) {
+  if (!ParseFilterAnd(parser)) return false;
+  while (AcceptToken(parser.p, parser.end, "||")) {
+    if (!ParseFilterAnd(parser)) return false;
+    EmitFilterOp(parser, { Filter_Or });
+  }
+  return true;
+}
+
+// Compiles e.g. `A > 3 && (name == "x" || !(C <= 10))`. Null cells never
+// match a comparison, negated or not: `!(A > 3)` selects A <= 3. An empty
+// expression compiles to an empty plan.
+bool CompileFilter(Table const& table, string_view text, FilterPlan& plan, char* error, size_t errorSize) {
+  plan = {};
+  FilterParser parser = { text.data(), text.data(), text.data() + text.size(), &table, &plan, 0, {} };
+  if (AcceptToken(parser.p, parser.end, "") && parser.p == parser.end) return true;
+
+  bool ok = ParseFilterOr(parser) && AcceptToken(parser.p, parser.end, "");
+  if (ok && parser.p != parser.end) ok = FilterError(parser, "unexpected text");
+  if (!ok) snprintf(error, errorSize, "%s", parser.error);
+  return ok;
+}
+
+template <typename T, typename V, typename Compare>
+void CompareBlock(const T* values, size_t count, V constant, Compare compare, uint64_t* mask) {
+  for (size_t base = 0; base < count; base += 64) {
+    size_t n = min((size_t)64, count - base);
+    uint64_t bits = 0;
+    for (size_t i = 0; i < n; ++i) bits |= (uint64_t)compare(values[base + i], constant) << i;
+    mask[base / 64] = bits;
+  }
+}
+
+template <typename T, typename V>
+void CompareBlock(const T* values, size_t count, CompareOp op, V constant, uint64_t* mask) {
+  switch (op) {
+    case Compare_Eq: CompareBlock(values, count, constant, equal_to<>(), mask); break;
+    case Compare_Ne: CompareBlock(values, count, constant, not_equal_to<>(), mask); break;
+    case Compare_Lt: CompareBlock(values, count, constant, less<>(), mask); break;
+    case Compare_Le: CompareBlock(values, count, constant, less_equal<>(), mask); break;
+    case Compare_Gt: CompareBlock(values, count, constant, greater<>(), mask); break;
+    case Compare_Ge: CompareBlock(values, count, constant, greater_equal<>(), mask); break;
+  }
+}
+
+bool CompareText(string_view value, CompareOp op, string_view constant) {
+  int c = value.compare(constant);
+  switch (op) {
+    case Compare_Eq: return c == 0;
+    case Compare_Ne: return c != 0;
+    case Compare_Lt: return c < 0;
+    case Compare_Le: return c <= 0;
+    case Compare_Gt: return c > 0;
+    case Compare_Ge: return c >= 0;
+  }
+  return false;
+}
+
+// Runs the plan over rows [begin, end), begin a multiple of 64, and appends
+// the matching rows. Each op works on whole columns of the block at once so
+// the comparison loops vectorize.
+// Each stack entry is a pair of masks, the rows where the expression is
+// true and the rows where it is false. A null cell is in neither, so it
+// stays out of a comparison and of its negation alike.
+void FilterBlock(Table const& table, FilterPlan const& plan, size_t begin, size_t end, vector<uint64_t>& stack, vector<uint32_t>& rows) {
+  constexpr size_t WORDS = FILTER_BLOCK_ROWS / 64;
+  size_t count = end - begin;
+  size_t wordCount = (count + 63) / 64;
+  uint64_t tailMask = count % 64 ? ((uint64_t)1 << (count % 64)) - 1 : ~(uint64_t)0;
+
+  size_t depth = 0;
+  for (auto const& op : plan.ops) {
+    if (op.kind == Filter_Compare) {
+      uint64_t* mask = &stack[2*depth*WORDS];
+      uint64_t* falseMask = mask + WORDS;
+      ++depth;
+      Column const& col = table.columns[op.col];
+      if (col.type == Column_Int64) {
+        int64_t whole = (int64_t)op.number;
+        if ((double)whole == op.number) CompareBlock(col.ints.data + begin, count, op.compare, whole, mask);
+        else CompareBlock(col.ints.data + begin, count, op.compare, op.number, mask);
+      } else if (col.type == Column_Double) {
+        CompareBlock(col.doubles.data + begin, count, op.compare, op.number, mask);
+      } else {
+        memset(mask, 0, wordCount*sizeof(uint64_t));
+        for (size_t row = begin; row < end; ++row) {
+          if (CellIsNull(col, row)) continue;
+          mask[(row - begin) / 64] |= (uint64_t)CompareText(CellString(col, row), op.compare, op.text) << (row - begin) % 64;
+        }
+      }
+      for (size_t w = 0; w < wordCount; ++w) {
+        uint64_t valid = col.valid.data[begin / 64 + w];
+        falseMask[w] = ~mask[w] & valid;
+        mask[w] &= valid;
+      }
+      mask[wordCount - 1] &= tailMask;
+      falseMask[wordCount - 1] &= tailMask;
+    } else if (op.kind == Filter_Not) {
+      uint64_t* mask = &stack[2*(depth - 1)*WORDS];
+      swap_ranges(mask, mask + wordCount, mask + WORDS);
+    } else {
+      --depth;
+      uint64_t* a = &stack[2*(depth - 1)*WORDS];
+      uint64_t* b = &stack[2*depth*WORDS];
+      if (op.kind == Filter_And) {
+        for (size_t w = 0; w < wordCount; ++w) {
+          a[w] &= b[w];
+          a[WORDS + w] |= b[WORDS + w];
+        }
+      } else {
+        for (size_t w = 0; w < wordCount; ++w) {
+          a[w] |= b[w];
+          a[WORDS + w] &= b[WORDS + w];
+        }
+      }
+    }
+  }
+
+  for (size_t w = 0; w < wordCount; ++w) {
+    for (uint64_t bits = stack[w]; bits; bits &= bits - 1) rows.push_back(begin + w*64 + countr_zero(bits));
+  }
+}
+
+// Returns the selection vector: the rows matching the plan, in table order.
+vector<uint32_t> FilterRows(Table const& table, FilterPlan const& plan, stop_token const& stop) {
+  size_t rowCount = table.rowCount;
+  size_t chunkCount = RowChunkCount(rowCount);
+  vector<vector<uint32_t>> parts(chunkCount);
+  ParallelFor(chunkCount, [&](size_t i) {
+    size_t begin = RowChunkBegin(rowCount, i, chunkCount);
+    size_t end = RowChunkBegin(rowCount, i + 1, chunkCount);
+    auto& rows = parts[i];
+    if (plan.ops.empty()) {
+      rows.resize(end - begin);
+      iota(rows.begin(), rows.end(), (uint32_t)begin);
+      return;
+    }
+
+    vector<uint64_t> stack(2*plan.stackDepth*FILTER_BLOCK_ROWS / 64);
+    for (size_t block = begin; block < end && !stop.stop_requested(); block += FILTER_BLOCK_ROWS) {
+      FilterBlock(table, plan, block, min(end, block + FILTER_BLOCK_ROWS), stack, rows);
+    }
+  });
+
+  if (chunkCount == 1) return std::move(parts[0]);
+  vector<size_t> offsets(chunkCount + 1);
+  for (size_t i = 0; i < chunkCount; ++i) offsets[i + 1] = offsets[i] + parts[i].size();
+  vector<uint32_t> rows(offsets.back());
+  ParallelFor(chunkCount, [&](size_t i) {
+    copy(parts[i].begin(), parts[i].end(), rows.begin() + offsets[i]);
+    parts[i] = {};
+  });
+  return rows;
+}
+
+// Maps a numeric cell to an unsigned key with the same order.
+uint64_t SortKey(Column const& col, size_t row) {
+  if (col.type == Column_Int64) return (uint64_t)col.ints.data[row] ^ ((uint64_t)1 << 63);
+  uint64_t bits;
+  memcpy(&bits, &col.doubles.data[row], sizeof(bits));
+  return bits >> 63 ? ~bits : bits | ((uint64_t)1 << 63);
+}
+
+// Stable LSD radix sort of rows by key, 8 bits per pass. Each thread counts
+// digits in its own slice, then scatters the slice to offsets computed from
+// all the counts, so slices stay in order. Passes where every key shares
+// the digit are skipped, which makes small or narrow keys cheap.
+void RadixSortRows(vector<uint64_t>& keys, vector<uint32_t>& rows, stop_token const& stop) {
+  size_t n = rows.size();
+  size_t chunkCount = RowChunkCount(n);
+  vector<uint64_t> keysOut(n);
+  vector<uint32_t> rowsOut(n);
+  vector<array<size_t, 256>> counts(chunkCount);
+
+  for (int shift = 0; shift < 64 && !stop.stop_requested(); shift += 8) {
+    ParallelFor(chunkCount, [&](size_t i) {
+      auto& count = counts[i];
+      count.fill(0);
+      for (size_t k = n*i/chunkCount; k < n*(i + 1)/chunkCount; ++k) ++count[keys[k] >> shift & 255];
+    });
+
+    size_t offset = 0;
+    bool sameDigit = false;
+    for (size_t digit = 0; digit < 256; ++digit) {
+      size_t start = offset;
+      for (auto& count : counts) {
+        size_t c = count[digit];
+        count[digit] = offset;
+        offset += c;
+      }
+      if (offset - start == n) sameDigit = true;
+    }
+    if (sameDigit) continue;
+
+    ParallelFor(chunkCount, [&](size_t i) {
+      auto& next = counts[i];
+      for (size_t k = n*i/chunkCount; k < n*(i + 1)/chunkCount; ++k) {
+        size_t to = next[keys[k] >> shift & 255]++;
+        keysOut[to] = keys[k];
+        rowsOut[to] = rows[k];
+      }
+    });
+    keys.swap(keysOut);
+    rows.swap(rowsOut);
+  }
+}
+
+// Reorders the selected rows by one column. Numbers go through the radix
+// sort, text through a comparison sort. Nulls always come last.
+void SortRows(Table const& table, size_t sortCol, bool descending, vector<uint32_t>& rows, stop_token const& stop) {
+  Column const& col = table.columns[sortCol];
+  if (col.type == Column_String) {
+    stable_sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) {
+      bool nullA = CellIsNull(col, a), nullB = CellIsNull(col, b);
+      if (nullA || nullB) return !nullA && nullB;
+      int c = CellString(col, a).compare(CellString(col, b));
+      return descending ? c > 0 : c < 0;
+    });
+    return;
+  }
+
+  vector<uint64_t> keys(rows.size());
+  size_t chunkCount = RowChunkCount(rows.size());
+  ParallelFor(chunkCount, [&](size_t i) {
+    for (size_t k = rows.size()*i/chunkCount; k < rows.size()*(i + 1)/chunkCount; ++k) {
+      uint64_t key = SortKey(col, rows[k]);
+      keys[k] = CellIsNull(col, rows[k]) ? UINT64_MAX : descending ? ~key : key;
+    }
+  });
+  RadixSortRows(keys, rows, stop);
+}
+
+void RunQueries(stop_token stop, QueryWorker& q) {
+  uint64_t handled = 0;
+  uint64_t statsHandled = 0;
+  while (true) {
+    QueryRequest request;
+    bool runQuery = false, runStats = false, rescan = false;
+    Table const* statsTable = nullptr;
+    vector<CellChange> changes;
+    {
+      unique_lock l(q.lock);
+      if (!q.wakeup.wait(l, stop, [&] { return q.requested != handled || q.statsRequested != statsHandled; })) return;
+      if (q.requested != handled) {
+        request = q.request;
+        handled = q.requested;
+        runQuery = true;
+      }
+      if (q.statsRequested != statsHandled) {
+        statsTable = q.statsTable;
+        rescan = q.statsRescan;
+        q.statsRescan = false;
+        changes.swap(q.statsChanges);
+        statsHandled = q.statsRequested;
+        runStats = true;
+      }
+    }
+
+    if (runQuery) {
+      auto startTime = chrono::steady_clock::now();
+      vector<uint32_t> rows = FilterRows(*request.table, request.filter, stop);
+      if (request.sortCol >= 0) SortRows(*request.table, request.sortCol, request.descending, rows, stop);
+      if (stop.stop_requested()) return;
+
+      lock_guard l(q.lock);
+      q.rows = std::move(rows);
+      q.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+      q.finished = handled;
+    }
+
+    if (runStats) {
+      UpdateWorkerStats(q, *statsTable, rescan, changes);
+      vector<ColumnSummary> summaries(q.stats.size());
+      for (size_t c = 0; c < q.stats.size(); ++c) summaries[c] = SummarizeColumn(q.stats[c]);
+      if (stop.stop_requested()) return;
+
+      lock_guard l(q.lock);
+      q.summaries = std::move(summaries);
+      q.statsFinished = statsHandled;
+    }
+  }
+}
+
+bool QueryBusy(App& app) {
+  QueryWorker& q = *app.query;
+  return q.requested != q.finished || q.statsRequested != q.statsFinished;
+}
+
+// Drops the view along with any result still in flight for it, which
+// would otherwise bring the old rows back when it lands.
+void ResetView(App& app) {
+  app.viewActive = false;
+  app.viewRows = {};
+  app.viewResetAt = app.query->requested;
+  app.queryStatus[0] = 0;
+}
+
+// Compiles filterText and hands it to the worker with the current sort.
+// With neither a filter nor a sort the table shows through unchanged.
+void StartQuery(App& app, const char* filterText) {
+  QueryRequest request = { &app.table, {}, app.sortCol, app.sortDescending };
+  if (!CompileFilter(app.table, filterText, request.filter, app.queryStatus, sizeof(app.queryStatus))) return;
+
+  if (request.filter.ops.empty() && request.sortCol < 0) {
+    ResetView(app);
+    return;
+  }
+  if (filterText != app.appliedFilter) strncpy(app.appliedFilter, filterText, sizeof(app.appliedFilter) - 1);
+
+  QueryWorker& q = *app.query;
+  lock_guard l(q.lock);
+  q.request = std::move(request);
+  ++q.requested;
+  q.wakeup.notify_one();
+}
+
+void SubmitQuery(App& app) {
+  StartQuery(app, app.filterText);
+}
+
+// Reruns the active view after an edit, with the filter that produced it
+// rather than whatever has been typed in the bar since.
+void RefreshQuery(App& app) {
+  if (app.viewActive) StartQuery(app, app.appliedFilter);
+}
+
+// Picks up the worker's latest result, if any.
+void PollQuery(App& app) {
+  QueryWorker& q = *app.query;
+  if (q.finished == app.viewGeneration) return;
+
+  lock_guard l(q.lock);
+  app.viewGeneration = q.finished;
+  if (q.finished <= app.viewResetAt) return;
+  app.viewRows = std::move(q.rows);
+  app.viewActive = true;
+  snprintf(app.queryStatus, sizeof(app.queryStatus), "%zu of %zu rows (%.1f ms)", app.viewRows.size(), app.table.rowCount, q.seconds*1000.0);
+}
+
+// The table changed shape: drop the view and the sort, keep the filter text.
+void InvalidateQuery(App& app) {
+  ResetView(app);
+  app.sortCol = -1;
+}
+
+struct FormulaParser {
+  const char* p;
+  const char* end;
+  Formula* formula;
+};
+
+uint32_t PushFormulaNode(Formula& formula, FormulaNode node) {
+  formula.nodes.push_back(node);
+  return formula.nodes.size() - 1;
+}
+
+// Parses A1 or $A$1 into a zero-based row and column.
+bool ParseCellName(const char*& p, const char* end, uint32_t& row, uint32_t& col) {
+  AcceptToken(p, end, "");
+  const char* q = p;
+  if (q < end && *q == '$') ++q;
+  const char* letters = q;
+  size_t index = 0;
+  while (q < end && isalpha((unsigned char)*q)) index = index*26 + (toupper(*q++) - 'A' + 1);
+  if (q == letters || q - letters > 4) return false;
+  if (q < end && *q == '$') ++q;
+
+  uint64_t number = 0;
+  auto [ptr, ec] = from_chars(q, end, number);
+  if (ec != errc() || number == 0 || number > UINT32_MAX) return false;
+  row = number - 1;
+  col = index - 1;
+  p = ptr;
+  return true;
+}
+
+bool ParseFormulaExpr(FormulaParser& parser, uint32_t& node);
+
+// A function argument: a range like A1:B10, or any expression.
+bool ParseFormulaArg(FormulaParser& parser, uint32_t& node) {
+  const char* start = parser.p;
+  FormulaRef ref;
+  if (ParseCellName(parser.p, parser.end, ref.rowBegin, ref.colBegin) && AcceptToken(parser.p, parser.end, ":") &&
+      ParseCellName(parser.p, parser.end, ref.rowEnd, ref.colEnd)) {
+    if (ref.rowBegin > ref.rowEnd) swap(ref.rowBegin, ref.rowEnd);
+    if (ref.colBegin > ref.colEnd) swap(ref.colBegin, ref.colEnd);
+    node = PushFormulaNode(*parser.formula, { Formula_Range, 0, 0, 0.0, ref });
+    return true;
+  }
+  parser.p = start;
+  return ParseFormulaExpr(parser, node);
+}
+
+bool ParseFormulaPrimary(FormulaParser& parser, uint32_t& node) {
+  Formula& formula = *parser.formula;
+  if (AcceptToken(parser.p, parser.end, "(")) {
+    return ParseFormulaExpr(parser, node) && AcceptToken(parser.p, parser.end, ")");
+  }
+  if (AcceptToken(parser.p, parser.end, "-")) {
+    uint32_t operand;
+    if (!ParseFormulaPrimary(parser, operand)) return false;
+    node = PushFormulaNode(formula, { Formula_Neg, operand });
+    return true;
+  }
+
+  static const pair<string_view, FormulaOp> functions[] = {
+    { "SUM", Formula_Sum }, { "AVERAGE", Formula_Average }, { "AVG", Formula_Average },
+    { "MIN", Formula_Min }, { "MAX", Formula_Max }, { "COUNT", Formula_Count },
+  };
+  const char* q = parser.p;
+  while (q < parser.end && isalpha((unsigned char)*q)) ++q;
+  string_view name(parser.p, q - parser.p);
+  for (auto [function, op] : functions) {
+    bool same = name.size() == function.size() && equal(name.begin(), name.end(), function.begin(), [](char a, char b) { return toupper(a) == b; });
+    if (!same || !AcceptToken(q, parser.end, "(")) continue;
+
+    parser.p = q;
+    vector<uint32_t> args;
+    if (!AcceptToken(parser.p, parser.end, ")")) {
+      do {
+        uint32_t arg;
+        if (!ParseFormulaArg(parser, arg)) return false;
+        args.push_back(arg);
+      } while (AcceptToken(parser.p, parser.end, ","));
+      if (!AcceptToken(parser.p, parser.end, ")")) return false;
+    }
+    node = PushFormulaNode(formula, { op, (uint32_t)formula.args.size(), (uint32_t)args.size() });
+    formula.args.insert(formula.args.end(), args.begin(), args.end());
+    return true;
+  }
+
+  FormulaRef ref;
+  if (ParseCellName(parser.p, parser.end, ref.rowBegin, ref.colBegin)) {
+    ref.rowEnd = ref.rowBegin;
+    ref.colEnd = ref.colBegin;
+    node = PushFormulaNode(formula, { Formula_Cell, 0, 0, 0.0, ref });
+    return true;
+  }
+
+  double number;
+  auto [ptr, ec] = from_chars(parser.p, parser.end, number);
+  if (ec != errc()) return false;
+  parser.p = ptr;
+  node = PushFormulaNode(formula, { Formula_Number, 0, 0, number });
+  return true;
+}
+
+bool ParseFormulaTerm(FormulaParser& parser, uint32_t& node) {
+  if (!ParseFormulaPrimary(parser, node)) return false;
+  while (true) {
+    FormulaOp op;
+    if (AcceptToken(parser.p, parser.end, "*")) op = Formula_Mul;
+    else if (AcceptToken(parser.p, parser.end, "/")) op = Formula_Div;
+    else return true;
+
+    uint32_t rhs;
+    if (!ParseFormulaPrimary(parser, rhs)) return false;
+    node = PushFormulaNode(*parser.formula, { op, node, rhs });
+  }
+}
+
+bool ParseFormulaExpr(FormulaParser& parser, uint32_t& node) {
+  if (!ParseFormulaTerm(parser, node)) return false;
+  while (true) {
+    FormulaOp op;
+    if (AcceptToken(parser.p, parser.end, "+")) op = Formula_Add;
+    else if (AcceptToken(parser.p, parser.end, "-")) op = Formula_Sub;
+    else return true;
+
+    uint32_t rhs;
+    if (!ParseFormulaTerm(parser, rhs)) return false;
+    node = PushFormulaNode(*parser.formula, { op, node, rhs });
+  }
+}
+
+// Compiles text such as `=SUM(A1:A100)/2 + B2*C2` into a formula whose root
+// is its last node, and collects the cells it reads.
+bool CompileFormula(string_view text, Formula& formula) {
+  formula = {};
+  if (text.empty() || text[0] != '=') return false;
+
+  FormulaParser parser = { text.data() + 1, text.data() + text.size(), &formula };
+  uint32_t root;
+  if (!ParseFormulaExpr(parser, root) || !AcceptToken(parser.p, parser.end, "") || parser.p != parser.end) return false;
 
-using namespace std;
+  for (auto const& node : formula.nodes) {
+    if (node.op == Formula_Cell || node.op == Formula_Range) formula.refs.push_back(node.ref);
+  }
+  auto key = [](FormulaRef const& r) { return tuple(r.rowBegin, r.rowEnd, r.colBegin, r.colEnd); };
+  sort(formula.refs.begin(), formula.refs.end(), [&](FormulaRef const& a, FormulaRef const& b) { return key(a) < key(b); });
+  formula.refs.erase(unique(formula.refs.begin(), formula.refs.end(), [&](FormulaRef const& a, FormulaRef const& b) { return key(a) == key(b); }), formula.refs.end());
+  formula.text = text;
+  return true;
+}
 
-size_t MAX_ROW_COUNT = 30;
-size_t MAX_COL_COUNT = 30;
-const char* SAVE_PATH = "csvtool.csv";
+// Blank cells read as 0, text that isn't a number is an error, and so is a
+// cell whose own formula failed.
+double FormulaCellValue(FormulaSheet const& sheet, Table const& table, size_t row, size_t col, const char*& error) {
+  if (row >= table.rowCount || col >= table.columns.size()) return 0.0;
 
-auto POPUP_FLAGS = ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoScrollbar;
+  Column const& column = table.columns[col];
+  if (CellIsNull(column, row)) {
+    if (Formula const* formula = CellFormula(sheet, row, col)) {
+      if (formula->error) error = formula->error;
+      else if (formula->held) return formula->value;
+    }
+    return 0.0;
+  }
+  if (column.type != Column_String) return CellAsDouble(column, row);
 
-struct App {
-  float w, h;
+  string_view text = CellString(column, row);
+  double value;
+  if (auto [ptr, ec] = from_chars(text.data(), text.data() + text.size(), value); ec == errc() && ptr == text.data() + text.size()) return value;
+  error = "#VALUE!";
+  return NAN;
+}
+
+// Folds the numbers of a range into running aggregates. Blank and text
+// cells are skipped, as spreadsheets do.
+void AggregateRange(FormulaSheet const& sheet, Table const& table, FormulaRef const& ref, double& sum, double& low, double& high, size_t& count) {
+  if (table.rowCount == 0) return;
+  size_t rowEnd = min((size_t)ref.rowEnd, table.rowCount - 1);
+  size_t colEnd = min((size_t)ref.colEnd, table.columns.size() - 1);
+  for (size_t col = ref.colBegin; col <= colEnd; ++col) {
+    Column const& column = table.columns[col];
+    for (size_t row = ref.rowBegin; row <= rowEnd; ++row) {
+      double value;
+      if (CellIsNull(column, row)) {
+        Formula const* formula = CellFormula(sheet, row, col);
+        if (!formula || !formula->held) continue;
+        value = formula->value;
+      } else if (column.type == Column_Int64) value = (double)column.ints[row];
+      else if (column.type == Column_Double) value = column.doubles[row];
+      else {
+        string_view text = CellString(column, row);
+        auto [ptr, ec] = from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != errc() || ptr != text.data() + text.size()) continue;
+      }
+      sum += value;
+      low = min(low, value);
+      high = max(high, value);
+      ++count;
+    }
+  }
+}
 
-  vector<vector<float>> table;
+double EvalFormulaNode(FormulaSheet const& sheet, Table const& table, Formula const& formula, uint32_t index, const char*& error) {
+  FormulaNode const& node = formula.nodes[index];
+  auto operand = [&](uint32_t i) { return EvalFormulaNode(sheet, table, formula, i, error); };
 
-  size_t clickedRow;
-  size_t clickedCol;
+  switch (node.op) {
+    case Formula_Number: return node.number;
+    case Formula_Cell  : return FormulaCellValue(sheet, table, node.ref.rowBegin, node.ref.colBegin, error);
+    case Formula_Range : error = "#VALUE!"; return NAN;
+    case Formula_Add   : return operand(node.a) + operand(node.b);
+    case Formula_Sub   : return operand(node.a) - operand(node.b);
+    case Formula_Mul   : return operand(node.a) * operand(node.b);
+    case Formula_Neg   : return -operand(node.a);
+    case Formula_Div   : {
+      double numerator = operand(node.a);
+      double denominator = operand(node.b);
+      if (denominator == 0.0) error = "#DIV/0!";
+      return numerator / denominator;
+    }
+    default: break;
+  }
+
+  double sum = 0.0, low = INFINITY, high = -INFINITY;
+  size_t count = 0;
+  for (uint32_t i = node.a; i < node.a + node.b; ++i) {
+    uint32_t arg = formula.args[i];
+    if (formula.nodes[arg].op == Formula_Range) {
+      AggregateRange(sheet, table, formula.nodes[arg].ref, sum, low, high, count);
+      continue;
+    }
+    double value = operand(arg);
+    sum += value;
+    low = min(low, value);
+    high = max(high, value);
+    ++count;
+  }
+
+  switch (node.op) {
+    case Formula_Sum    : return sum;
+    case Formula_Average: if (count == 0) error = "#DIV/0!"; return sum / count;
+    case Formula_Min    : return count ? low : 0.0;
+    case Formula_Max    : return count ? high : 0.0;
+    case Formula_Count  : return count;
+    default: return NAN;
+  }
+}
+
+// Recomputes the running max of the last rows from index `from` on.
+void UpdateRangeReach(vector<RangeDependency> const& deps, vector<uint32_t>& reach, size_t from) {
+  reach.resize(deps.size());
+  for (size_t i = from; i < deps.size(); ++i) reach[i] = max(i ? reach[i - 1] : 0, deps[i].rowEnd);
+}
+
+void SortRangeDependencies(FormulaSheet& sheet) {
+  for (size_t col = 0; col < sheet.rangeDependents.size(); ++col) {
+    auto& deps = sheet.rangeDependents[col];
+    sort(deps.begin(), deps.end(), [](RangeDependency const& a, RangeDependency const& b) { return a.rowBegin < b.rowBegin; });
+    UpdateRangeReach(deps, sheet.rangeReach[col], 0);
+  }
+  sheet.rangesDirty = false;
+}
+
+void InsertRangeDependency(FormulaSheet& sheet, uint32_t col, RangeDependency dep) {
+  if (col >= sheet.rangeDependents.size()) {
+    sheet.rangeDependents.resize(col + 1);
+    sheet.rangeReach.resize(col + 1);
+  }
+  auto& deps = sheet.rangeDependents[col];
+  if (sheet.rangesDirty) {
+    deps.push_back(dep);
+    return;
+  }
+
+  auto at = upper_bound(deps.begin(), deps.end(), dep.rowBegin, [](uint32_t row, RangeDependency const& d) { return row < d.rowBegin; });
+  size_t index = at - deps.begin();
+  deps.insert(at, dep);
+  UpdateRangeReach(deps, sheet.rangeReach[col], index);
+}
+
+void EraseRangeDependency(FormulaSheet& sheet, uint32_t col, RangeDependency dep) {
+  auto& deps = sheet.rangeDependents[col];
+  auto begin = deps.begin();
+  if (!sheet.rangesDirty) {
+    begin = lower_bound(deps.begin(), deps.end(), dep.rowBegin, [](RangeDependency const& d, uint32_t row) { return d.rowBegin < row; });
+  }
+  auto it = find_if(begin, deps.end(), [&](RangeDependency const& d) { return d.formula == dep.formula && d.rowBegin == dep.rowBegin; });
+  if (it == deps.end()) return;
+
+  size_t index = it - deps.begin();
+  deps.erase(it);
+  if (!sheet.rangesDirty) UpdateRangeReach(deps, sheet.rangeReach[col], index);
+}
+
+uint32_t AddFormula(FormulaSheet& sheet, size_t row, size_t col, Formula&& formula) {
+  uint32_t id;
+  if (!sheet.freeSlots.empty()) {
+    id = sheet.freeSlots.back();
+    sheet.freeSlots.pop_back();
+  } else {
+    id = sheet.formulas.size();
+    sheet.formulas.emplace_back();
+    sheet.visited.push_back(0);
+    sheet.indegree.push_back(0);
+  }
+
+  formula.cell = CellKey(row, col);
+  sheet.byCell[formula.cell] = id;
+  if (col >= sheet.columnCounts.size()) sheet.columnCounts.resize(col + 1);
+  ++sheet.columnCounts[col];
+
+  for (auto const& ref : formula.refs) {
+    if (ref.rowBegin == ref.rowEnd && ref.colBegin == ref.colEnd) {
+      sheet.cellDependents[CellKey(ref.rowBegin, ref.colBegin)].push_back(id);
+      continue;
+    }
+    for (uint32_t c = ref.colBegin; c <= ref.colEnd; ++c) InsertRangeDependency(sheet, c, { ref.rowBegin, ref.rowEnd, id });
+  }
+  sheet.formulas[id] = std::move(formula);
+  return id;
+}
+
+void RemoveFormula(FormulaSheet& sheet, uint32_t id) {
+  Formula& formula = sheet.formulas[id];
+  for (auto const& ref : formula.refs) {
+    if (ref.rowBegin == ref.rowEnd && ref.colBegin == ref.colEnd) {
+      auto it = sheet.cellDependents.find(CellKey(ref.rowBegin, ref.colBegin));
+      auto& ids = it->second;
+      ids.erase(find(ids.begin(), ids.end(), id));
+      if (ids.empty()) sheet.cellDependents.erase(it);
+      continue;
+    }
+    for (uint32_t c = ref.colBegin; c <= ref.colEnd; ++c) EraseRangeDependency(sheet, c, { ref.rowBegin, ref.rowEnd, id });
+  }
+
+  sheet.byCell.erase(formula.cell);
+  --sheet.columnCounts[formula.cell & 0xFFFFFF];
+  formula = {};
+  formula.cell = UINT64_MAX;
+  sheet.freeSlots.push_back(id);
+}
+
+bool RemoveCellFormula(FormulaSheet& sheet, size_t row, size_t col) {
+  auto it = sheet.byCell.find(CellKey(row, col));
+  if (it == sheet.byCell.end()) return false;
+  RemoveFormula(sheet, it->second);
+  return true;
+}
+
+// Collects the formulas reading a cell directly.
+void FormulaDependents(FormulaSheet const& sheet, uint64_t cell, vector<uint32_t>& out) {
+  out.clear();
+  if (auto it = sheet.cellDependents.find(cell); it != sheet.cellDependents.end()) {
+    out.insert(out.end(), it->second.begin(), it->second.end());
+  }
+
+  size_t row = cell >> 24;
+  size_t col = cell & 0xFFFFFF;
+  if (col >= sheet.rangeDependents.size()) return;
+  auto const& deps = sheet.rangeDependents[col];
+  auto const& reach = sheet.rangeReach[col];
+  size_t end = upper_bound(deps.begin(), deps.end(), row, [](size_t r, RangeDependency const& d) { return r < d.rowBegin; }) - deps.begin();
+  for (size_t i = end; i-- > 0 && reach[i] >= row;) {
+    if (deps[i].rowEnd >= row) out.push_back(deps[i].formula);
+  }
+}
+
+void StoreFormulaResult(FormulaSheet& sheet, Table& table, uint32_t id, double value, const char* error, vector<CellChange>* changes) {
+  Formula& formula = sheet.formulas[id];
+  if (!error && !isfinite(value)) error = "#NUM!";
+  formula.error = error;
+
+  uint32_t col = formula.cell & 0xFFFFFF;
+  Column& column = table.columns[col];
+  size_t row = formula.cell >> 24;
+  double oldValue = changes ? CellAsDouble(column, row) : NAN;
+  formula.value = value;
+  formula.held = false;
+  // A fraction in an int column stays with the formula: storing it would
+  // turn every int of the column into a double.
+  bool whole = value == trunc(value) && fabs(value) < 0x1p53;
+  if (error) {
+    SetCellNull(column, row);
+  } else if (column.type == Column_Int64 && !whole) {
+    SetCellNull(column, row);
+    formula.held = true;
+  } else if (column.type == Column_Int64) {
+    SetCellInt(column, row, (int64_t)value);
+  } else {
+    SetCellDouble(column, row, value);
+  }
+  if (changes) changes->push_back({ col, oldValue, CellAsDouble(column, row) });
+}
+
+// Re-evaluates the roots and everything depending on them, transitively.
+// A search from the roots finds the affected formulas and counts, for each,
+// how many affected formulas it reads; then they're evaluated in waves of
+// those whose inputs are all done (Kahn's order). A wave has no internal
+// dependencies so it's evaluated in parallel, then written to the table
+// before the next one. Formulas left over are on or behind a cycle.
+// Returns how many formulas were recalculated; changes, if given, gets the
+// old and new value of each.
+size_t RecalculateFormulas(FormulaSheet& sheet, Table& table, vector<uint32_t> const& roots, vector<CellChange>* changes = nullptr) {
+  if (sheet.rangesDirty) SortRangeDependencies(sheet);
+  uint32_t epoch = ++sheet.epoch;
+
+  vector<uint32_t> affected;
+  auto visit = [&](uint32_t id) {
+    if (sheet.visited[id] == epoch) return;
+    sheet.visited[id] = epoch;
+    sheet.indegree[id] = 0;
+    affected.push_back(id);
+  };
+  for (uint32_t id : roots) visit(id);
+
+  vector<uint32_t> deps;
+  for (size_t i = 0; i < affected.size(); ++i) {
+    FormulaDependents(sheet, sheet.formulas[affected[i]].cell, deps);
+    for (uint32_t d : deps) {
+      visit(d);
+      ++sheet.indegree[d];
+    }
+  }
+
+  vector<uint32_t> wave, next;
+  for (uint32_t id : affected) {
+    if (sheet.indegree[id] == 0) wave.push_back(id);
+  }
+
+  vector<double> values;
+  vector<const char*> errors;
+  while (!wave.empty()) {
+    values.resize(wave.size());
+    errors.assign(wave.size(), nullptr);
+    size_t chunkCount = max((size_t)1, min(ThreadCount(), wave.size() / 1024));
+    ParallelFor(chunkCount, [&](size_t c) {
+      for (size_t i = wave.size()*c/chunkCount; i < wave.size()*(c + 1)/chunkCount; ++i) {
+        Formula const& formula = sheet.formulas[wave[i]];
+        values[i] = EvalFormulaNode(sheet, table, formula, formula.nodes.size() - 1, errors[i]);
+      }
+    });
+    for (size_t i = 0; i < wave.size(); ++i) StoreFormulaResult(sheet, table, wave[i], values[i], errors[i], changes);
+
+    next.clear();
+    for (uint32_t id : wave) {
+      FormulaDependents(sheet, sheet.formulas[id].cell, deps);
+      for (uint32_t d : deps) {
+        if (--sheet.indegree[d] == 0) next.push_back(d);
+      }
+    }
+    wave.swap(next);
+  }
+
+  for (uint32_t id : affected) {
+    if (sheet.indegree[id] > 0) StoreFormulaResult(sheet, table, id, NAN, "#CYCLE!", changes);
+  }
+  return affected.size();
+}
+
+// Recalculates after an edit of (row, col): the cell itself if it holds a
+// formula, else the formulas reading it.
+size_t RecalculateFromCell(FormulaSheet& sheet, Table& table, size_t row, size_t col, vector<CellChange>* changes = nullptr) {
+  if (sheet.byCell.empty()) return 0;
+  if (sheet.rangesDirty) SortRangeDependencies(sheet);
+
+  uint64_t cell = CellKey(row, col);
+  vector<uint32_t> roots;
+  if (auto it = sheet.byCell.find(cell); it != sheet.byCell.end()) roots.push_back(it->second);
+  else FormulaDependents(sheet, cell, roots);
+  return roots.empty() ? 0 : RecalculateFormulas(sheet, table, roots, changes);
+}
+
+size_t RecalculateAll(FormulaSheet& sheet, Table& table) {
+  vector<uint32_t> roots;
+  roots.reserve(sheet.byCell.size());
+  for (uint32_t id = 0; id < sheet.formulas.size(); ++id) {
+    if (sheet.formulas[id].cell != UINT64_MAX) roots.push_back(id);
+  }
+  return RecalculateFormulas(sheet, table, roots);
+}
+
+// Formulas outside a shrunk table go, and the rest may have read cells
+// that are gone.
+void TrimFormulas(FormulaSheet& sheet, Table& table) {
+  if (sheet.byCell.empty()) return;
+
+  vector<uint32_t> outside;
+  for (auto [cell, id] : sheet.byCell) {
+    if ((cell >> 24) >= table.rowCount || (cell & 0xFFFFFF) >= table.columns.size()) outside.push_back(id);
+  }
+  for (uint32_t id : outside) RemoveFormula(sheet, id);
+  RecalculateAll(sheet, table);
+}
+
+// After a load, text cells starting with '=' become formulas. Their text
+// made the column a text column, so columns holding formulas are retyped
+// from their remaining cells. Returns the number of formulas.
+size_t LoadFormulas(FormulaSheet& sheet, Table& table) {
+  sheet = {};
+  sheet.rangesDirty = true;
+
+  size_t rowCount = table.rowCount;
+  for (size_t col = 0; col < table.columns.size(); ++col) {
+    Column& column = table.columns[col];
+    if (column.type != Column_String) continue;
+
+    size_t chunkCount = RowChunkCount(rowCount);
+    vector<vector<pair<size_t, Formula>>> compiled(chunkCount);
+    ParallelFor(chunkCount, [&](size_t i) {
+      for (size_t row = RowChunkBegin(rowCount, i, chunkCount); row < RowChunkBegin(rowCount, i + 1, chunkCount); ++row) {
+        if (CellIsNull(column, row) || !CellString(column, row).starts_with('=')) continue;
+        Formula formula;
+        if (CompileFormula(CellString(column, row), formula)) compiled[i].emplace_back(row, std::move(formula));
+      }
+    });
+
+    size_t total = sheet.formulas.size();
+    for (auto const& formulas : compiled) total += formulas.size();
+    sheet.formulas.reserve(total);
+    sheet.byCell.reserve(total);
+    sheet.cellDependents.reserve(total);
+
+    bool any = false;
+    for (auto& formulas : compiled) {
+      for (auto& [row, formula] : formulas) AddFormula(sheet, row, col, std::move(formula));
+      any = any || !formulas.empty();
+    }
+    if (!any) continue;
+
+    // Cells that aren't numbers keep the column a text column, with every
+    // cell as written.
+    bool numeric = true;
+    for (size_t row = 0; row < rowCount && numeric; ++row) {
+      if (CellIsNull(column, row) || sheet.byCell.count(CellKey(row, col))) continue;
+      string_view text = CellString(column, row);
+      double d;
+      auto [ptr, ec] = from_chars(text.data(), text.data() + text.size(), d);
+      numeric = ec == errc() && ptr == text.data() + text.size();
+    }
+    if (!numeric) continue;
+
+    Column retyped = {};
+    retyped.name = std::move(column.name);
+    ColumnResize(retyped, rowCount);
+    for (size_t row = 0; row < rowCount; ++row) {
+      if (CellIsNull(column, row) || sheet.byCell.count(CellKey(row, col))) continue;
+      SetCellFromText(retyped, row, CellString(column, row));
+    }
+    column = std::move(retyped);
+  }
+
+  RecalculateAll(sheet, table);
+  return sheet.byCell.size();
+}
+
+// Binary snapshot of a table, for reloads without parsing. Layout: header,
+// column descriptors, column names, then every block (values, string
+// offsets, lengths and chars, validity bits, formulas) starting on a 64
+// byte boundary. Blocks are stored in memory order (little-endian on the
+// machines we build for), so a load maps the file copy-on-write and points
+// the column arrays straight into it. With compression, int columns whose
+// values span less than 32 bits are stored as 1, 2 or 4 byte deltas from
+// their minimum and are expanded on load. Validity bits of columns without
+// nulls are not stored at all.
+constexpr char SNAPSHOT_MAGIC[8] = { 'C', 'S', 'V', 'S', 'N', 'A', 'P', '\0' };
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+enum SnapshotEncoding : uint8_t {
+  Encoding_Raw,
+  Encoding_Delta8,
+  Encoding_Delta16,
+  Encoding_Delta32,
 };
 
-void AppInit(App& app, float w, float h) {
-    app = {};
-    app.w = w;
-    app.h = h;
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t columnCount;
+  uint64_t rowCount;
+  uint64_t formulaOffset;  // entries of { uint64_t cell; uint32_t length; char text[length]; }
+  uint64_t formulaBytes;
+  uint64_t formulaCount;
+};
+
+struct SnapshotColumn {
+  uint64_t nameOffset;
+  uint32_t nameLength;
+  uint8_t type;
+  uint8_t encoding;
+  uint8_t allValid;
+  uint8_t reserved;
+  int64_t base;             // subtracted from ints before packing
+  uint64_t valuesOffset;    // ints, doubles or string offsets
+  uint64_t lengthsOffset;
+  uint64_t charsOffset;
+  uint64_t charsBytes;
+  uint64_t validOffset;
+};
+
+// Gathers the blocks of a snapshot as iovecs, padding each to 64 bytes.
+struct SnapshotWriter {
+  vector<iovec> iov;
+  uint64_t size;
+};
+
+uint64_t PlaceBlock(SnapshotWriter& writer, const void* data, size_t bytes) {
+  static const char zeros[64] = {};
+  if (size_t pad = -writer.size & 63) {
+    writer.iov.push_back({ (void*)zeros, pad });
+    writer.size += pad;
+  }
+  uint64_t offset = writer.size;
+  if (bytes) writer.iov.push_back({ (void*)data, bytes });
+  writer.size += bytes;
+  return offset;
 }
 
-int fsize(FILE* f) {
-  if (fseek(f, 0, SEEK_END) == -1) {
-    return -1;
+template <typename T>
+void PackDeltas(Column const& col, size_t rowCount, int64_t base, Array<char>& out) {
+  out.resize(rowCount*sizeof(T));
+  T* packed = (T*)out.data;
+  size_t chunkCount = RowChunkCount(rowCount);
+  ParallelFor(chunkCount, [&](size_t i) {
+    for (size_t row = RowChunkBegin(rowCount, i, chunkCount); row < RowChunkBegin(rowCount, i + 1, chunkCount); ++row) {
+      packed[row] = (T)(uint64_t)(col.ints[row] - base);
+    }
+  });
+}
+
+template <typename T>
+void UnpackDeltas(const char* data, size_t rowCount, int64_t base, Array<int64_t>& ints) {
+  ints.resize(rowCount);
+  const T* packed = (const T*)data;
+  size_t chunkCount = RowChunkCount(rowCount);
+  ParallelFor(chunkCount, [&](size_t i) {
+    for (size_t row = RowChunkBegin(rowCount, i, chunkCount); row < RowChunkBegin(rowCount, i + 1, chunkCount); ++row) {
+      ints[row] = base + (int64_t)packed[row];
+    }
+  });
+}
+
+// Refuses paths ending in .csv, so a snapshot never replaces a CSV file.
+bool SaveSnapshot(const char* path, Table const& table, FormulaSheet const& formulas, bool compress, char* status, size_t statusSize) {
+  if (string_view(path).ends_with(".csv")) {
+    snprintf(status, statusSize, "Won't write a binary snapshot over %s", path);
+    return false;
+  }
+
+  auto startTime = chrono::steady_clock::now();
+  size_t rowCount = table.rowCount;
+  size_t colCount = table.columns.size();
+
+  SnapshotHeader header = {};
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.columnCount = colCount;
+  header.rowCount = rowCount;
+  vector<SnapshotColumn> descriptors(colCount);
+
+  SnapshotWriter writer = {};
+  PlaceBlock(writer, &header, sizeof(header));
+  PlaceBlock(writer, descriptors.data(), colCount*sizeof(SnapshotColumn));
+  for (size_t c = 0; c < colCount; ++c) {
+    descriptors[c].nameOffset = writer.size;
+    descriptors[c].nameLength = table.columns[c].name.size();
+    writer.iov.push_back({ (void*)table.columns[c].name.data(), table.columns[c].name.size() });
+    writer.size += table.columns[c].name.size();
+  }
+
+  // Scratch for columns that need rewriting: packed ints and compacted
+  // strings, whose arena may hold text of overwritten cells.
+  vector<Array<char>> packed(colCount);
+  vector<Array<uint64_t>> compactOffsets(colCount);
+  size_t validWords = (rowCount + 63) / 64;
+  for (size_t c = 0; c < colCount; ++c) {
+    Column const& col = table.columns[c];
+    SnapshotColumn& d = descriptors[c];
+    d.type = col.type;
+
+    d.allValid = all_of(col.valid.data, col.valid.data + rowCount / 64, [](uint64_t w) { return w == ~(uint64_t)0; });
+    if (rowCount % 64) {
+      uint64_t tail = ((uint64_t)1 << rowCount % 64) - 1;
+      d.allValid = d.allValid && (col.valid[rowCount / 64] & tail) == tail;
+    }
+    if (!d.allValid) d.validOffset = PlaceBlock(writer, col.valid.data, validWords*sizeof(uint64_t));
+
+    if (col.type == Column_Double) {
+      d.valuesOffset = PlaceBlock(writer, col.doubles.data, rowCount*sizeof(double));
+    } else if (col.type == Column_Int64) {
+      int64_t low = 0, high = 0;
+      if (compress && rowCount) {
+        auto [lo, hi] = minmax_element(col.ints.data, col.ints.data + rowCount);
+        low = *lo;
+        high = *hi;
+      }
+      uint64_t span = (uint64_t)high - (uint64_t)low;
+      if (compress && rowCount && span <= UINT32_MAX) {
+        d.base = low;
+        if (span <= UINT8_MAX) d.encoding = Encoding_Delta8, PackDeltas<uint8_t>(col, rowCount, low, packed[c]);
+        else if (span <= UINT16_MAX) d.encoding = Encoding_Delta16, PackDeltas<uint16_t>(col, rowCount, low, packed[c]);
+        else d.encoding = Encoding_Delta32, PackDeltas<uint32_t>(col, rowCount, low, packed[c]);
+        d.valuesOffset = PlaceBlock(writer, packed[c].data, packed[c].count);
+      } else {
+        d.valuesOffset = PlaceBlock(writer, col.ints.data, rowCount*sizeof(int64_t));
+      }
+    } else {
+      uint64_t used = 0;
+      for (size_t row = 0; row < rowCount; ++row) used += col.lengths[row];
+      const uint64_t* offsets = col.offsets.data;
+      const char* chars = col.chars.data;
+      if (used != col.chars.count) {
+        Array<uint64_t>& newOffsets = compactOffsets[c];
+        Array<char>& newChars = packed[c];
+        newOffsets.resize(rowCount);
+        newChars.resize(used);
+        for (size_t row = 0, at = 0; row < rowCount; ++row) {
+          newOffsets[row] = at;
+          if (col.lengths[row]) memcpy(newChars.data + at, CellString(col, row).data(), col.lengths[row]);
+          at += col.lengths[row];
+        }
+        offsets = newOffsets.data;
+        chars = newChars.data;
+      }
+      d.valuesOffset = PlaceBlock(writer, offsets, rowCount*sizeof(uint64_t));
+      d.lengthsOffset = PlaceBlock(writer, col.lengths.data, rowCount*sizeof(uint32_t));
+      d.charsOffset = PlaceBlock(writer, chars, used);
+      d.charsBytes = used;
+    }
+  }
+
+  Array<char> formulaBlock;
+  for (auto const& formula : formulas.formulas) {
+    if (formula.cell == UINT64_MAX) continue;
+    uint32_t length = formula.text.size();
+    AppendBytes(formulaBlock, string_view((const char*)&formula.cell, sizeof(formula.cell)));
+    AppendBytes(formulaBlock, string_view((const char*)&length, sizeof(length)));
+    AppendBytes(formulaBlock, formula.text);
+    ++header.formulaCount;
+  }
+  header.formulaOffset = PlaceBlock(writer, formulaBlock.data, formulaBlock.count);
+  header.formulaBytes = formulaBlock.count;
+
+  string tempPath;
+  int fd = CreateTempFile(path, tempPath, status, statusSize);
+  if (fd == -1) return false;
+  bool ok = true;
+  for (size_t i = 0; ok && i < writer.iov.size(); i += IOV_MAX) {
+    ok = WriteAll(fd, writer.iov.data() + i, min(writer.iov.size() - i, (size_t)IOV_MAX));
+  }
+  if (!CommitTempFile(fd, tempPath, path, ok, status, statusSize)) return false;
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Saved snapshot of %zu rows x %zu cols (%.1f MB) in %.3f s", rowCount, colCount, writer.size / 1e6, seconds);
+  return true;
+}
+
+bool LoadSnapshot(const char* path, Table& table, FormulaSheet& sheet, char* status, size_t statusSize) {
+  auto startTime = chrono::steady_clock::now();
+
+  MappedFile file;
+  if (!MapFile(path, file, status, statusSize, PROT_READ | PROT_WRITE)) return false;
+  shared_ptr<void> mapping((void*)file.data, [file](void*) {
+    MappedFile mapped = file;
+    UnmapFile(mapped);
+  });
+
+  char* data = (char*)file.data;
+  size_t size = file.size;
+  auto fail = [&](const char* reason) {
+    snprintf(status, statusSize, "%s: not a valid snapshot (%s)", path, reason);
+    return false;
+  };
+  auto inFile = [&](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+
+  SnapshotHeader header;
+  if (size < sizeof(header)) return fail("too small");
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) return fail("bad magic");
+  if (header.version != SNAPSHOT_VERSION) return fail("unknown version");
+  if (header.rowCount > UINT32_MAX) return fail("too many rows");
+
+  uint64_t descriptorOffset = (sizeof(header) + 63) & ~(uint64_t)63;
+  if (!inFile(descriptorOffset, header.columnCount*sizeof(SnapshotColumn))) return fail("truncated");
+  const SnapshotColumn* descriptors = (const SnapshotColumn*)(data + descriptorOffset);
+
+  Table newTable = {};
+  size_t rowCount = header.rowCount;
+  size_t validWords = (rowCount + 63) / 64;
+  newTable.rowCount = rowCount;
+  newTable.columns.resize(header.columnCount);
+  for (size_t c = 0; c < header.columnCount; ++c) {
+    SnapshotColumn const& d = descriptors[c];
+    Column& col = newTable.columns[c];
+    if (d.type > Column_String || d.encoding > Encoding_Delta32) return fail("bad column");
+    if (!inFile(d.nameOffset, d.nameLength)) return fail("truncated");
+    col.type = (ColumnType)d.type;
+    col.name.assign(data + d.nameOffset, d.nameLength);
+
+    if (d.allValid) {
+      col.valid.resize(validWords);
+      memset(col.valid.data, 0xff, validWords*sizeof(uint64_t));
+    } else {
+      if (!inFile(d.validOffset, validWords*sizeof(uint64_t)) || d.validOffset % 64) return fail("truncated");
+      col.valid.borrow((uint64_t*)(data + d.validOffset), validWords);
+    }
+
+    size_t valueSize = d.encoding == Encoding_Delta8 ? 1 : d.encoding == Encoding_Delta16 ? 2 : d.encoding == Encoding_Delta32 ? 4 : 8;
+    if (!inFile(d.valuesOffset, rowCount*valueSize) || d.valuesOffset % 64) return fail("truncated");
+    char* values = data + d.valuesOffset;
+    if (col.type == Column_Double) {
+      col.doubles.borrow((double*)values, rowCount);
+    } else if (col.type == Column_Int64) {
+      switch (d.encoding) {
+        case Encoding_Raw    : col.ints.borrow((int64_t*)values, rowCount); break;
+        case Encoding_Delta8 : UnpackDeltas<uint8_t>(values, rowCount, d.base, col.ints); break;
+        case Encoding_Delta16: UnpackDeltas<uint16_t>(values, rowCount, d.base, col.ints); break;
+        case Encoding_Delta32: UnpackDeltas<uint32_t>(values, rowCount, d.base, col.ints); break;
+      }
+    } else {
+      if (!inFile(d.lengthsOffset, rowCount*sizeof(uint32_t)) || d.lengthsOffset % 64) return fail("truncated");
+      if (!inFile(d.charsOffset, d.charsBytes)) return fail("truncated");
+      col.offsets.borrow((uint64_t*)values, rowCount);
+      col.lengths.borrow((uint32_t*)(data + d.lengthsOffset), rowCount);
+      col.chars.borrow(data + d.charsOffset, d.charsBytes);
+
+      // The only per-row check: a bad offset would read outside the chars.
+      atomic<bool> inBounds = true;
+      size_t chunkCount = RowChunkCount(rowCount);
+      ParallelFor(chunkCount, [&](size_t i) {
+        for (size_t row = RowChunkBegin(rowCount, i, chunkCount); row < RowChunkBegin(rowCount, i + 1, chunkCount); ++row) {
+          if (col.offsets[row] > d.charsBytes || col.lengths[row] > d.charsBytes - col.offsets[row]) {
+            inBounds = false;
+            return;
+          }
+        }
+      });
+      if (!inBounds) return fail("string out of bounds");
+    }
   }
-  int size = ftell(f);
-  if (size < 0) return -1;
-  rewind(f);
 
-  return size;
+  if (!inFile(header.formulaOffset, header.formulaBytes)) return fail("truncated");
+  FormulaSheet newSheet = {};
+  newSheet.rangesDirty = true;
+  const char* p = data + header.formulaOffset;
+  const char* end = p + header.formulaBytes;
+  for (uint64_t i = 0; i < header.formulaCount; ++i) {
+    uint64_t cell;
+    uint32_t length;
+    if (end - p < (ptrdiff_t)(sizeof(cell) + sizeof(length))) return fail("truncated formulas");
+    memcpy(&cell, p, sizeof(cell));
+    memcpy(&length, p + sizeof(cell), sizeof(length));
+    p += sizeof(cell) + sizeof(length);
+    if ((size_t)(end - p) < length) return fail("truncated formulas");
+
+    Formula formula;
+    size_t row = cell >> 24, col = cell & 0xFFFFFF;
+    if (row < rowCount && col < header.columnCount && CompileFormula(string_view(p, length), formula)) {
+      AddFormula(newSheet, row, col, std::move(formula));
+    }
+    p += length;
+  }
+  // Values were saved, but errors weren't.
+  if (!newSheet.byCell.empty()) RecalculateAll(newSheet, newTable);
+
+  newTable.mapping = std::move(mapping);
+  table = std::move(newTable);
+  sheet = std::move(newSheet);
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Loaded snapshot of %zu rows x %zu cols in %.3f ms", rowCount, table.columns.size(), seconds*1000.0);
+  return true;
 }
 
-bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+void DrawStatsPanel(App& app) {
+  Table& table = app.table;
+  if (!app.statsActive) {
+    app.statsActive = true;
+    RequestStats(app, true, {});
+  }
+
+  ImGui::BeginChild("##stats", ImVec2(0.0f, 260.0f), true);
+
+  auto tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+  if (app.stats.size() != table.columns.size()) {
+    ImGui::TextDisabled("Computing statistics...");
+  } else if (ImGui::BeginTable("##columnStats", 12, tableFlags, ImVec2(0.0f, 130.0f))) {
+    for (const char* header : { "Col", "Count", "Nulls", "Sum", "Min", "Max", "Mean", "Stddev", "p25", "p50", "p75", "p99" }) {
+      ImGui::TableSetupColumn(header);
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableHeadersRow();
+
+    ImGuiListClipper clipper;
+    clipper.Begin(table.columns.size());
+    while (clipper.Step()) {
+      for (int c = clipper.DisplayStart; c < clipper.DisplayEnd; ++c) {
+        ColumnSummary const& stats = app.stats[c];
+        char name[16];
+        ColumnLetters(c, name);
+
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%s", name);
+        if (!stats.numeric) {
+          ImGui::TableNextColumn();
+          ImGui::TextDisabled("text");
+          continue;
+        }
+
+        ImGui::TableNextColumn(); ImGui::Text("%zu", stats.count);
+        ImGui::TableNextColumn(); ImGui::Text("%zu", table.rowCount - stats.count);
+        ImGui::TableNextColumn(); ImGui::Text("%g", stats.sum);
+        ImGui::TableNextColumn(); ImGui::Text("%g", stats.min);
+        ImGui::TableNextColumn(); ImGui::Text("%g", stats.max);
+        ImGui::TableNextColumn(); ImGui::Text("%g", stats.mean);
+        ImGui::TableNextColumn(); ImGui::Text("%g", stats.stddev);
+        for (double q : stats.quantiles) {
+          ImGui::TableNextColumn(); ImGui::Text("%g", q);
+        }
+      }
+    }
+    ImGui::EndTable();
+  }
+
+  int colCount = table.columns.size();
+  app.groupKeyCol = min(app.groupKeyCol, max(colCount - 1, 0));
+  app.groupValueCol = min(app.groupValueCol, max(colCount - 1, 0));
+
+  ImGui::PushItemWidth(80.0f);
+  ImGui::Text("Group by");
+  ImGui::SameLine();
+  ImGui::SliderInt("##groupKey", &app.groupKeyCol, 0, max(colCount - 1, 0));
+  ImGui::SameLine();
+  ImGui::Text("aggregate");
+  ImGui::SameLine();
+  ImGui::SliderInt("##groupValue", &app.groupValueCol, 0, max(colCount - 1, 0));
+  ImGui::PopItemWidth();
+  ImGui::SameLine();
+  if (ImGui::Button("Group") && colCount > 0) {
+    app.groups = GroupBy(table, app.groupKeyCol, app.groupValueCol);
+  }
+
+  if (!app.groups.empty() && ImGui::BeginTable("##groups", 6, tableFlags, ImVec2(0.0f, 0.0f))) {
+    for (const char* header : { "Key", "Rows", "Sum", "Mean", "Min", "Max" }) {
+      ImGui::TableSetupColumn(header);
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableHeadersRow();
+
+    ImGuiListClipper clipper;
+    clipper.Begin(app.groups.size());
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+        GroupRow const& group = app.groups[i];
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn(); ImGui::TextUnformatted(group.key.data(), group.key.data() + group.key.size());
+        ImGui::TableNextColumn(); ImGui::Text("%zu", group.rows);
+        ImGui::TableNextColumn(); ImGui::Text("%g", group.sum);
+        ImGui::TableNextColumn(); ImGui::Text("%g", group.count ? group.sum / group.count : NAN);
+        ImGui::TableNextColumn(); ImGui::Text("%g", group.min);
+        ImGui::TableNextColumn(); ImGui::Text("%g", group.max);
+      }
+    }
+    ImGui::EndTable();
+  }
+
+  ImGui::EndChild();
+}
 
 void DrawSizeButtons(App& app) {
-  int rowCount = app.table.size();
-  int colCount = app.table.empty() ? 0 : app.table[0].size();
+  if (app.stream) {
+    ImGui::Text("Streaming %zu rows x %zu cols, %zu edited cells", app.stream->rowCount, app.stream->colCount, app.stream->edits.size());
+    return;
+  }
+
+  int rowCount = app.table.rowCount;
+  int colCount = app.table.columns.size();
 
   ImGui::Text("Num Rows: ");
   ImGui::SameLine();
-  ImGui::SliderInt("##numRows", &rowCount, 0, MAX_ROW_COUNT);
+  ImGui::SliderInt("##numRows", &rowCount, 0, max((int)MAX_ROW_COUNT, rowCount));
   ImGui::SameLine();
   if (ImGui::Button("Add Row")) ++rowCount;
   ImGui::SameLine();
@@ -56,83 +3244,188 @@ void DrawSizeButtons(App& app) {
 
   ImGui::Text("Num Cols: ");
   ImGui::SameLine();
-  ImGui::SliderInt("##numCols", &colCount, 0, MAX_COL_COUNT);
+  ImGui::SliderInt("##numCols", &colCount, 0, max((int)MAX_COL_COUNT, colCount));
   ImGui::SameLine();
   if (ImGui::Button("Add Col")) ++colCount;
   ImGui::SameLine();
   if (ImGui::Button("Drop Col")) --colCount;
 
-  app.table.resize(rowCount);
-  for (auto& row : app.table)
-    row.resize(colCount);
+  rowCount = max(rowCount, 0);
+  colCount = max(colCount, 0);
+  if (rowCount == app.table.rowCount && colCount == app.table.columns.size()) return;
+
+  bool shrunk = rowCount < app.table.rowCount || colCount < app.table.columns.size();
+  if (rowCount == app.table.rowCount + 1 && colCount == app.table.columns.size()) {
+    TableAppendRow(app.table);
+  } else if (colCount == app.table.columns.size() + 1 && rowCount == app.table.rowCount) {
+    TableAppendColumn(app.table);
+  } else {
+    TableResize(app.table, rowCount, colCount);
+  }
+  if (shrunk) TrimFormulas(app.formulas, app.table);
+  InvalidateCellCache(app);
+  InvalidateStats(app);
+  InvalidateQuery(app);
 }
 
 void DrawIoButtons(App& app) {
   if (ImGui::Button("Save")) {
-    FILE* f = fopen(SAVE_PATH, "w");
-    if (f) {
-      for (auto& row : app.table) {
-        for (float value : row) {
-          char buffer[128] = {};
-          snprintf(&buffer[0], sizeof(buffer) - 1, "%f", value);
-          assert(fwrite(buffer, 1, strlen(buffer), f) == strlen(buffer));
-          assert(fwrite(",", 1, 1, f) == 1);
-        }
-        assert(fwrite("\n", 1, 1, f) == 1);
-      }
-      fclose(f);
-    }
+    if (app.stream) SaveCsvStream(app.csvPath, app.hasHeader, *app.stream, app.status, sizeof(app.status));
+    else if (app.binary) SaveSnapshot(app.csvPath, app.table, app.formulas, app.compress, app.status, sizeof(app.status));
+    else SaveCsv(app.csvPath, app.hasHeader, app.table, app.formulas, app.status, sizeof(app.status));
   }
 
   ImGui::SameLine();
 
   if (ImGui::Button("Load")) {
-    FILE* f = fopen(SAVE_PATH, "r");
-    if (f) {
-      vector<vector<float>> newTable = {};
-      newTable.push_back({});
-
-      int size = fsize(f);
-      assert(size != -1);
-      vector<char> buffer(size+1, 0);
-      if (fread(buffer.data(), 1, size, f) == size) {
-        int floatStart = 0;
-        for (int i = 0; i < size; ++i) {
-          char c = buffer[i];
-          if (c == ',' || c == '\n') {
-            if (i - floatStart > 0) {
-              buffer[i] = 0;
-              float value = stof(&buffer[floatStart]);
-              buffer[i] = c;
-              newTable.back().push_back(value);
-            }
-
-            floatStart = i + 1;
-            if (c == '\n' && i != size - 1) {
-              newTable.push_back({});
-            }
-          } else if (!IsDigit(c) && c != '.' && c != '-' && c != '+') {
-            fprintf(stderr, "can't read csv file: found non-numbers: %c\n", c);
-          }
-        }
-
-        size_t colCount = newTable[0].size();
-        for (auto& row : newTable) {
-          assert(row.size() == colCount);
-        }
-
+    bool loaded = false;
+    if (app.binary) {
+      loaded = LoadSnapshot(app.csvPath, app.table, app.formulas, app.status, sizeof(app.status));
+    } else {
+      Table newTable = {};
+      loaded = LoadCsv(app.csvPath, app.hasHeader, newTable, app.status, sizeof(app.status));
+      if (loaded) {
         app.table = std::move(newTable);
+        if (size_t formulaCount = LoadFormulas(app.formulas, app.table)) {
+          size_t n = strlen(app.status);
+          snprintf(app.status + n, sizeof(app.status) - n, ", %zu formulas", formulaCount);
+        }
       }
+    }
+    if (loaded) {
+      app.stream = nullptr;
+      InvalidateCellCache(app);
+      InvalidateStats(app);
+      InvalidateQuery(app);
+    }
+  }
 
-      fclose(f);
+  ImGui::SameLine();
+
+  // For files larger than memory: index the rows and page them in on demand.
+  if (ImGui::Button("Stream")) {
+    auto stream = make_unique<CsvStream>();
+    if (OpenCsvStream(app.csvPath, app.hasHeader, *stream, app.status, sizeof(app.status))) {
+      app.table = {};
+      app.formulas = {};
+      app.stream = std::move(stream);
+      app.showStats = false;
+      InvalidateCellCache(app);
+      InvalidateStats(app);
+      InvalidateQuery(app);
     }
   }
 
   ImGui::SameLine();
 
   if (ImGui::Button("Clear")) {
-    app.table.clear();
+    app.table = {};
+    app.formulas = {};
+    app.stream = nullptr;
+    InvalidateCellCache(app);
+    InvalidateStats(app);
+    InvalidateQuery(app);
+  }
+
+  ImGui::SameLine();
+  ImGui::BeginDisabled(app.stream != nullptr);
+  if (ImGui::Checkbox("Stats", &app.showStats) && !app.showStats) {
+    InvalidateStats(app);
+  }
+  ImGui::EndDisabled();
+
+  ImGui::SameLine();
+  ImGui::Checkbox("Header", &app.hasHeader);
+
+  // Binary snapshots save and load the table as is, without parsing.
+  ImGui::SameLine();
+  ImGui::BeginDisabled(app.stream != nullptr);
+  if (ImGui::Checkbox("Binary", &app.binary)) {
+    // The default paths follow the format so a click can't mix them up.
+    const char* from = app.binary ? SAVE_PATH : SNAPSHOT_PATH;
+    const char* to = app.binary ? SNAPSHOT_PATH : SAVE_PATH;
+    if (strcmp(app.csvPath, from) == 0) strncpy(app.csvPath, to, sizeof(app.csvPath) - 1);
+  }
+  ImGui::EndDisabled();
+  ImGui::SameLine();
+  ImGui::BeginDisabled(!app.binary || app.stream != nullptr);
+  ImGui::Checkbox("Compress", &app.compress);
+  ImGui::EndDisabled();
+  ImGui::SameLine();
+  ImGui::InputText("Path", app.csvPath, sizeof(app.csvPath));
+
+  if (app.status[0]) {
+    ImGui::Text("%s", app.status);
+  }
+}
+
+void DrawQueryBar(App& app) {
+  ImGui::BeginDisabled(app.stream != nullptr);
+  ImGui::Text("Filter: ");
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(400.0f);
+  if (ImGui::InputTextWithHint("##filter", "A > 3 && C < 10", app.filterText, sizeof(app.filterText), ImGuiInputTextFlags_EnterReturnsTrue)) {
+    SubmitQuery(app);
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Apply")) SubmitQuery(app);
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) {
+    app.filterText[0] = 0;
+    InvalidateQuery(app);
+  }
+  ImGui::EndDisabled();
+
+  ImGui::SameLine();
+  if (QueryBusy(app)) ImGui::Text("Running...");
+  else ImGui::TextUnformatted(app.queryStatus);
+}
+
+// Stores the popup's text in the clicked cell. Streamed files keep it in
+// the edit overlay; loaded tables update the cell and its column stats.
+void ApplyCellEdit(App& app) {
+  CellCacheEntry& entry = CellCacheSlot(app, app.clickedRow, app.clickedCol);
+  if (app.stream) {
+    app.stream->edits[{ app.clickedRow, app.clickedCol }] = app.editBuffer;
+    entry.row = UINT64_MAX;
+    return;
+  }
+
+  auto startTime = chrono::steady_clock::now();
+  size_t row = app.clickedRow;
+  size_t col = app.clickedCol;
+  string_view text = app.editBuffer;
+  vector<CellChange> changes;
+  if (text.starts_with('=')) {
+    Formula formula;
+    if (!CompileFormula(text, formula)) {
+      snprintf(app.status, sizeof(app.status), "Can't parse formula %s", app.editBuffer);
+      return;
+    }
+    RemoveCellFormula(app.formulas, row, col);
+    AddFormula(app.formulas, row, col, std::move(formula));
+  } else {
+    RemoveCellFormula(app.formulas, row, col);
+    Column& column = app.table.columns[col];
+    ColumnType oldType = column.type;
+    double oldValue = CellAsDouble(column, row);
+    SetCellFromText(column, row, text);
+    if (column.type != oldType) InvalidateCellCache(app);
+    else entry.row = UINT64_MAX;
+    changes.push_back({ (uint32_t)col, oldValue, CellAsDouble(column, row) });
+  }
+
+  // Dependents changed too, so the cached text and stats are stale.
+  size_t recalculated = RecalculateFromCell(app.formulas, app.table, row, col, &changes);
+  UpdateStatsForChanges(app, changes);
+  if (recalculated) {
+    InvalidateCellCache(app);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    snprintf(app.status, sizeof(app.status), "Recalculated %zu formulas in %.3f ms", recalculated, seconds*1000.0);
   }
+
+  // The edited values may no longer pass the filter or keep the order.
+  RefreshQuery(app);
 }
 
 void DrawValuePopup(App& app) {
@@ -140,18 +3433,16 @@ void DrawValuePopup(App& app) {
   static ImVec2 popUpSize = {300.0f, 100.0f};
   static ImVec2 popUpPos = {0.5f*(1280.0f - popUpSize.x), 0.5f*(720.0f - popUpSize.y)};
 
-  static char buffer[64] = {};
-
   ImGui::SetNextWindowSize(popUpSize);
   ImGui::SetNextWindowPos(popUpPos);
 
   if (ImGui::BeginPopupModal("Change Value", nullptr, POPUP_FLAGS)) {
     char labelBuffer[64] = {};
     snprintf(labelBuffer, sizeof(labelBuffer) - 1, "##%zu_%zu", app.clickedRow, app.clickedCol);
-    ImGui::InputText(labelBuffer, buffer, sizeof(buffer));
+    ImGui::InputText(labelBuffer, app.editBuffer, sizeof(app.editBuffer));
 
     if (ImGui::Button("Save", popUpButtonSize)) {
-      app.table[app.clickedRow][app.clickedCol] = stof(buffer);
+      ApplyCellEdit(app);
       ImGui::CloseCurrentPopup();
     }
 
@@ -165,47 +3456,141 @@ void DrawValuePopup(App& app) {
   }
 }
 
+// Draws only the cells in view: ImGuiListClipper picks the visible rows and
+// the visible columns follow from the horizontal scroll, so the cost per
+// frame doesn't depend on the table size. Column and row headers stay
+// pinned while scrolling.
 void DrawTable(App& app) {
-  static auto tableFlags = ImGuiTableFlags_BordersV | ImGuiTableFlags_BordersOuter;
+  size_t rowCount = ViewRowCount(app);
+  size_t colCount = ViewColCount(app);
+  if (rowCount == 0) return;
+  if (colCount == 0) return;
+  if (app.cellCache.empty()) InvalidateCellCache(app);
+
+  float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+  bool mapped = rowCount > TABLE_SCROLL_ROWS;
+  auto childFlags = ImGuiWindowFlags_HorizontalScrollbar | (mapped ? ImGuiWindowFlags_NoScrollWithMouse : 0);
+  ImGui::SetNextWindowContentSize(ImVec2(ROW_HEADER_WIDTH + colCount*CELL_WIDTH, (min(rowCount, TABLE_SCROLL_ROWS) + 1)*rowHeight));
+  ImGui::BeginChild("##table", ImVec2(0.0f, 0.0f), true, childFlags);
+
+  ImDrawList* drawList = ImGui::GetWindowDrawList();
+  ImVec2 origin = ImGui::GetCursorScreenPos();
+  float scrollX = ImGui::GetScrollX();
+  float scrollY = ImGui::GetScrollY();
+  float viewWidth = ImGui::GetWindowWidth();
+  float pinnedX = origin.x + scrollX;
+  float pinnedY = origin.y + scrollY;
+
+  size_t firstCol = (size_t)(max(0.0f, scrollX - ROW_HEADER_WIDTH) / CELL_WIDTH);
+  size_t lastCol = min(colCount, (size_t)((scrollX + viewWidth) / CELL_WIDTH) + 1);
 
-  if (app.table.empty()) return;
-  if (app.table[0].empty()) return;
+  // Rows are placed relative to topRow rather than to the scroll position.
+  // Past TABLE_SCROLL_ROWS the scroll fraction picks topRow, and the wheel
+  // moves topRow by whole rows, then the scrollbar follows.
+  size_t pageRows = max((size_t)(ImGui::GetWindowHeight() / rowHeight), (size_t)1);
+  if (!mapped) {
+    app.topRow = scrollY / rowHeight;
+  } else {
+    double maxTop = (double)(rowCount - min(rowCount, pageRows - 1));
+    float scrollMaxY = max(ImGui::GetScrollMaxY(), 1.0f);
+    float wheel = ImGui::IsWindowHovered() ? ImGui::GetIO().MouseWheel : 0.0f;
+    if (wheel != 0.0f) {
+      app.topRow = clamp(floor(app.topRow) - wheel*3.0, 0.0, maxTop);
+      app.mappedScrollY = (float)(app.topRow / maxTop * scrollMaxY);
+      ImGui::SetScrollY(app.mappedScrollY);
+    } else if (fabs(scrollY - app.mappedScrollY) >= 1.0f) {
+      app.topRow = scrollY / scrollMaxY * maxTop;
+      app.mappedScrollY = scrollY;
+    }
+    app.topRow = clamp(app.topRow, 0.0, maxTop);
+  }
+  size_t firstRow = min((size_t)app.topRow, rowCount);
+  size_t lastRow = min(rowCount, firstRow + pageRows + 1);
+  auto rowY = [&](size_t row) { return pinnedY + (float)((double)row - app.topRow + 1.0)*rowHeight; };
 
-  size_t colCount = app.table[0].size();
-  ImGui::BeginTable("Table", colCount, tableFlags);
+  ImU32 textColor = ImGui::GetColorU32(ImGuiCol_Text);
+  ImU32 headerColor = ImGui::GetColorU32(ImGuiCol_TableHeaderBg);
+  ImU32 borderColor = ImGui::GetColorU32(ImGuiCol_TableBorderLight);
+  float padding = 4.0f;
 
-  assert(colCount < 127);
-  for (char i = 0; i < colCount; ++i) {
-    char colName[2] = {};
-    colName[0] = 'A' + i;
-    ImGui::TableSetupColumn(&colName[0], ImGuiTableColumnFlags_WidthFixed, 1280.0f / (float)(colCount));
+  for (size_t col = firstCol; col < lastCol; ++col) {
+    float x = origin.x + ROW_HEADER_WIDTH + col*CELL_WIDTH;
+    drawList->PushClipRect(ImVec2(x, pinnedY), ImVec2(x + CELL_WIDTH - padding, pinnedY + 1e6f), true);
+    for (size_t row = firstRow; row < lastRow; ++row) {
+      string_view text = CachedCellText(app, ViewRow(app, row), col);
+      drawList->AddText(ImVec2(x + padding, rowY(row)), textColor, text.data(), text.data() + text.size());
+    }
+    drawList->PopClipRect();
+    drawList->AddLine(ImVec2(x, pinnedY), ImVec2(x, pinnedY + 1e6f), borderColor);
   }
 
-  ImGui::TableNextRow(ImGuiTableRowFlags_Headers);
+  // Pinned row numbers, then the pinned column header on top of everything.
+  drawList->AddRectFilled(ImVec2(pinnedX, pinnedY), ImVec2(pinnedX + ROW_HEADER_WIDTH, pinnedY + 1e6f), headerColor);
+  for (size_t row = firstRow; row < lastRow; ++row) {
+    char label[24];
+    int n = to_chars(label, label + sizeof(label), ViewRow(app, row) + 1).ptr - label;
+    drawList->AddText(ImVec2(pinnedX + padding, rowY(row)), textColor, label, label + n);
+  }
 
-  for (char i = 0; i < colCount; ++i) {
-    ImGui::TableNextColumn();
-    ImGui::Text("%c", 'A' + i);
+  drawList->AddRectFilled(ImVec2(pinnedX, pinnedY), ImVec2(pinnedX + viewWidth, pinnedY + rowHeight), headerColor);
+  for (size_t col = firstCol; col < lastCol; ++col) {
+    float x = max(origin.x + ROW_HEADER_WIDTH + col*CELL_WIDTH, pinnedX + ROW_HEADER_WIDTH);
+    char label[96];
+    int n = ColumnLetters(col, label);
+    string_view name = ViewColumnName(app, col);
+    if (!name.empty()) {
+      n += snprintf(label + n, sizeof(label) - n, " %.*s", (int)name.size(), name.data());
+      n = min(n, (int)sizeof(label) - 1);
+    }
+    if ((int)col == app.sortCol) {
+      n += snprintf(label + n, sizeof(label) - n, app.sortDescending ? " v" : " ^");
+      n = min(n, (int)sizeof(label) - 1);
+    }
+    drawList->PushClipRect(ImVec2(x, pinnedY), ImVec2(origin.x + ROW_HEADER_WIDTH + (col + 1)*CELL_WIDTH - padding, pinnedY + rowHeight), true);
+    drawList->AddText(ImVec2(origin.x + ROW_HEADER_WIDTH + col*CELL_WIDTH + padding, pinnedY), textColor, label, label + n);
+    drawList->PopClipRect();
   }
 
-  for (size_t row = 0; row < app.table.size(); ++row) {
-    for (size_t col = 0; col < app.table[0].size(); ++col) {
-      ImGui::TableNextColumn();
-      ImGui::Text("%f", app.table[row][col]);
-      if (ImGui::IsItemClicked()) {
+  // One hit test per frame instead of one per cell. Clicking a header cycles
+  // its sort through ascending, descending and off.
+  ImVec2 mouse = ImGui::GetMousePos();
+  bool busy = QueryBusy(app);
+  if (ImGui::IsWindowHovered() && !app.stream && !busy && ImGui::IsMouseClicked(ImGuiMouseButton_Left) &&
+      mouse.x >= pinnedX + ROW_HEADER_WIDTH && mouse.y >= pinnedY && mouse.y < pinnedY + rowHeight) {
+    size_t col = (size_t)((mouse.x - origin.x - ROW_HEADER_WIDTH) / CELL_WIDTH);
+    if (col < colCount) {
+      if (app.sortCol != (int)col) {
+        app.sortCol = col;
+        app.sortDescending = false;
+      } else if (!app.sortDescending) {
+        app.sortDescending = true;
+      } else {
+        app.sortCol = -1;
+      }
+      SubmitQuery(app);
+    }
+  }
+  if (ImGui::IsWindowHovered() && mouse.x >= pinnedX + ROW_HEADER_WIDTH && mouse.y >= pinnedY + rowHeight) {
+    size_t col = (size_t)((mouse.x - origin.x - ROW_HEADER_WIDTH) / CELL_WIDTH);
+    size_t row = (size_t)(app.topRow + (mouse.y - pinnedY - rowHeight) / rowHeight);
+    if (row < rowCount && col < colCount) {
+      row = ViewRow(app, row);
+      if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) && !busy) {
         ImGui::OpenPopup("Change Value");
         app.clickedRow = row;
         app.clickedCol = col;
-      } else if (ImGui::IsItemHovered()) {
-        ImGui::SetTooltip("Cell: (%zu, %zu)", row, col);
+        app.editBuffer[FormatEditText(app, row, col, app.editBuffer, sizeof(app.editBuffer) - 1)] = 0;
+      } else {
+        char colName[16];
+        ColumnLetters(col, colName);
+        ImGui::SetTooltip("Cell: %s%zu", colName, row + 1);
       }
     }
-    ImGui::TableNextRow();
   }
 
   DrawValuePopup(app);
 
-  ImGui::EndTable();
+  ImGui::EndChild();
 }
 
 void AppUpdateAndRender(App& app) {
@@ -214,12 +3599,21 @@ void AppUpdateAndRender(App& app) {
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
     ImGui::Begin("Csv Tool", nullptr, flags);
 
+    // The query worker reads the table, so hold edits until it's done.
+    PollQuery(app);
+    PollStats(app);
+    ImGui::BeginDisabled(QueryBusy(app));
     DrawSizeButtons(app);
     ImGui::Separator();
     DrawIoButtons(app);
+    ImGui::EndDisabled();
+    ImGui::Separator();
+    DrawQueryBar(app);
     ImGui::Separator();
+    if (app.showStats) {
+      DrawStatsPanel(app);
+    }
     DrawTable(app);
 
     ImGui::End();
 }
-
@@ -1,17 +1,851 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace fs = std::filesystem;
 
+enum FileOpKind {
+  FileOp_Copy,
+  FileOp_Move,
+  FileOp_Delete,
+  FileOp_Rename,
+};
+
+struct FileOp {
+  FileOpKind kind;
+  fs::path src;
+  fs::path dst;
+};
+
+// File operations run on a background thread so that a huge delete or a
+// cross-filesystem copy never blocks the UI. The UI thread only pushes ops
+// and reads the atomics below to draw progress.
+struct FileOpQueue {
+  mutex lock;
+  condition_variable_any wakeup;
+  deque<FileOp> pending;   // guarded by lock
+  string current;          // guarded by lock
+  string lastError;        // guarded by lock
+  vector<FileOp> renamed;  // guarded by lock, done renames the UI hasn't seen
+
+  atomic<bool> cancel;
+  atomic<bool> busy;
+  atomic<uint64_t> bytesDone, bytesTotal;
+  atomic<uint64_t> itemsDone, itemsTotal;
+
+  // Declared last so it is joined before the rest of the queue goes away.
+  jthread worker;
+};
+
+constexpr size_t PREVIEW_TEXT_BYTES = 16 << 10;
+constexpr size_t PREVIEW_HEX_BYTES = 4 << 10;
+constexpr size_t PREVIEW_CACHE_BUDGET = 32 << 20;
+
+// Must match the canvas of paint.cpp, whose .bin files are raw RGBA dumps.
+constexpr size_t PAINT_CANVAS_WIDTH = 800;
+constexpr size_t PAINT_CANVAS_HEIGHT = 600;
+constexpr size_t THUMBNAIL_SCALE = 4;
+constexpr size_t THUMBNAIL_WIDTH = PAINT_CANVAS_WIDTH / THUMBNAIL_SCALE;
+constexpr size_t THUMBNAIL_HEIGHT = PAINT_CANVAS_HEIGHT / THUMBNAIL_SCALE;
+
+enum PreviewKind {
+  Preview_Text,
+  Preview_Hex,
+  Preview_Canvas,
+  Preview_Error,
+};
+
+struct Preview {
+  fs::path path;
+  int64_t mtime;
+  PreviewKind kind;
+
+  string text;              // file head, hex dump or error message
+  vector<uint32_t> pixels;  // RGBA thumbnail for Paint canvases
+};
+
+size_t PreviewMemory(Preview const& p) {
+  return sizeof(Preview) + p.path.native().capacity() + p.text.capacity() + p.pixels.capacity()*sizeof(uint32_t);
+}
+
+// Previews are produced by a worker and kept in an LRU cache bounded by
+// PREVIEW_CACHE_BUDGET bytes. There is a single request slot rather than a
+// queue: a newer selection overwrites the older one and aborts its read, so
+// scrolling through a big directory only ever previews where it lands.
+struct PreviewCache {
+  mutex lock;
+  condition_variable_any wakeup;
+  fs::path wanted;                                             // guarded by lock
+  int64_t wantedMTime;                                         // guarded by lock, of wanted when requested
+  list<shared_ptr<Preview>> lru;                               // guarded by lock, most recent first
+  unordered_map<string, list<shared_ptr<Preview>>::iterator> index;  // guarded by lock
+  size_t memory;                                               // guarded by lock
+
+  atomic<uint64_t> generation;
+
+  jthread worker;
+};
+
+constexpr size_t TREE_POOL_BLOCK_SIZE = 4096;
+constexpr size_t TREE_NODE_BUDGET = 64 * 1024;
+
+enum TreeNodeState : uint8_t {
+  TreeNode_Unloaded,
+  TreeNode_Loading,
+  TreeNode_Loaded,
+};
+
+// A directory in the side tree. Only directories are listed, children are
+// enumerated the first time a node is opened.
+struct TreeNode {
+  TreeNode* parent;
+  TreeNode* firstChild;
+  TreeNode* nextSibling;  // also links the pool's free list
+
+  uint64_t serial;        // unique per allocation, detects reuse of a freed node
+  int lastOpenFrame;
+  TreeNodeState state;
+
+  char name[NAME_MAX + 1];
+};
+
+// Nodes come from fixed-size blocks that are never returned to the heap, so
+// expanding and evicting thousands of directories recycles the same memory
+// instead of fragmenting it.
+struct TreeNodePool {
+  vector<unique_ptr<TreeNode[]>> blocks;
+  TreeNode* freeList;
+  size_t liveCount;
+  uint64_t nextSerial;
+};
+
+struct TreeExpandJob {
+  TreeNode* node;
+  uint64_t serial;
+  fs::path path;
+};
+
+struct TreeExpandResult {
+  TreeNode* node;
+  uint64_t serial;
+  vector<string> names;
+};
+
+// Enumerates directories off the UI thread. Results are only applied by the
+// UI thread, which owns the pool, so the worker never touches a TreeNode.
+struct TreeLoader {
+  mutex lock;
+  condition_variable_any wakeup;
+  deque<TreeExpandJob> jobs;          // guarded by lock
+  vector<TreeExpandResult> results;   // guarded by lock
+
+  jthread worker;
+};
+
 struct App {
   float w, h;
 
   fs::path cwd;
   fs::path selectedPath;
+  set<fs::path> selection;
   char extensionFilter[16];
 
+  vector<fs::path> clipboard;
+  bool clipboardIsCut;
+
+  unique_ptr<FileOpQueue> ops;
+
+  unique_ptr<PreviewCache> previews;
+  shared_ptr<Preview> preview;
+  GLuint previewTexture;
+
+  TreeNodePool treePool;
+  TreeNode* treeRoot;
+  TreeNode* treeSelected;
+  uint64_t treeSelectedSerial;
+  unique_ptr<TreeLoader> treeLoader;
+
   bool shouldShowRenamePopup;
   bool shouldShowDeletePopup;
 };
 
+bool FileOpCancelled(FileOpQueue& q, stop_token const& stop) {
+  return q.cancel || stop.stop_requested();
+}
+
+void FileOpError(FileOpQueue& q, fs::path const& path, const char* what, const char* reason) {
+  lock_guard l(q.lock);
+  q.lastError = string(what) + " " + path.string() + ": " + reason;
+}
+
+void FileOpError(FileOpQueue& q, fs::path const& path, const char* what, int err) {
+  FileOpError(q, path, what, strerror(err));
+}
+
+// Copies one regular file with zero-copy I/O. copy_file_range lets the kernel
+// (or the filesystem, e.g. reflinks) do the work; sendfile is the fallback for
+// kernels and filesystems that refuse cross-device copy_file_range. The copy
+// goes in bounded chunks so that cancellation stays responsive.
+bool CopyFileContents(FileOpQueue& q, stop_token const& stop, fs::path const& src, fs::path const& dst) {
+  constexpr size_t CHUNK_SIZE = 16 << 20;
+
+  int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in == -1) {
+    FileOpError(q, src, "open", errno);
+    return false;
+  }
+
+  struct stat st = {};
+  if (fstat(in, &st) == -1) {
+    FileOpError(q, src, "fstat", errno);
+    close(in);
+    return false;
+  }
+
+  int out = open(dst.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+  if (out == -1) {
+    FileOpError(q, dst, "open", errno);
+    close(in);
+    return false;
+  }
+
+  bool ok = true;
+  bool useSendfile = false;
+  off_t remaining = st.st_size;
+  while (remaining > 0) {
+    if (FileOpCancelled(q, stop)) {
+      ok = false;
+      break;
+    }
+
+    size_t chunk = min((size_t)remaining, CHUNK_SIZE);
+    ssize_t n = -1;
+    if (!useSendfile) {
+      n = copy_file_range(in, nullptr, out, nullptr, chunk, 0);
+      if (n == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+        useSendfile = true;
+      }
+    }
+    if (useSendfile) {
+      n = sendfile(out, in, nullptr, chunk);
+    }
+
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) {
+      FileOpError(q, src, useSendfile ? "sendfile" : "copy_file_range", errno);
+      ok = false;
+      break;
+    }
+    if (n == 0) break;  // file shrank under us
+
+    remaining -= n;
+    q.bytesDone += n;
+  }
+
+  close(in);
+  if (close(out) == -1 && ok) {
+    FileOpError(q, dst, "close", errno);
+    ok = false;
+  }
+  if (!ok) unlink(dst.c_str());
+
+  return ok;
+}
+
+bool CopyTree(FileOpQueue& q, stop_token const& stop, fs::path const& src, fs::path const& dst) {
+  error_code ec;
+  if (fs::exists(fs::symlink_status(dst, ec))) {
+    FileOpError(q, dst, "copy", EEXIST);
+    return false;
+  }
+
+  auto status = fs::symlink_status(src, ec);
+  if (fs::is_symlink(status)) {
+    fs::copy_symlink(src, dst, ec);
+    if (ec) FileOpError(q, src, "copy_symlink", ec.value());
+    return !ec;
+  }
+  if (!fs::is_directory(status)) {
+    q.itemsTotal = 1;
+    q.bytesTotal = fs::file_size(src, ec);
+    bool ok = CopyFileContents(q, stop, src, dst);
+    ++q.itemsDone;
+    return ok;
+  }
+
+  // Size the tree up front so the progress bar means something.
+  uint64_t bytesTotal = 0, itemsTotal = 1;
+  for (auto it = fs::recursive_directory_iterator(src, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (FileOpCancelled(q, stop)) return false;
+    ++itemsTotal;
+    if (it->is_regular_file(ec)) bytesTotal += it->file_size(ec);
+  }
+  q.itemsTotal = itemsTotal;
+  q.bytesTotal = bytesTotal;
+
+  if (!fs::create_directory(dst, ec)) {
+    FileOpError(q, dst, "mkdir", ec ? ec.value() : EEXIST);
+    return false;
+  }
+  ++q.itemsDone;
+
+  bool ok = true;
+  for (auto it = fs::recursive_directory_iterator(src, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    if (FileOpCancelled(q, stop)) return false;
+
+    fs::path target = dst / fs::relative(it->path(), src, ec);
+    auto entryStatus = it->symlink_status(ec);
+    if (fs::is_symlink(entryStatus)) {
+      fs::copy_symlink(it->path(), target, ec);
+    } else if (fs::is_directory(entryStatus)) {
+      fs::create_directory(target, ec);
+    } else if (fs::is_regular_file(entryStatus)) {
+      ok = CopyFileContents(q, stop, it->path(), target) && ok;
+    }
+
+    if (ec) {
+      FileOpError(q, it->path(), "copy", ec.value());
+      ok = false;
+      ec.clear();
+    }
+    ++q.itemsDone;
+  }
+
+  return ok && !ec;
+}
+
+// Deletes bottom-up one entry at a time rather than calling remove_all, so a
+// huge tree reports progress and can be cancelled halfway.
+bool DeleteTree(FileOpQueue& q, stop_token const& stop, fs::path const& path) {
+  error_code ec;
+  vector<fs::path> entries;
+  if (fs::is_directory(fs::symlink_status(path, ec))) {
+    for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+      if (FileOpCancelled(q, stop)) return false;
+      entries.push_back(it->path());
+    }
+  }
+  entries.push_back(path);
+  q.itemsTotal = entries.size();
+
+  // Pre-order iteration reversed gives children before their parents.
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    if (FileOpCancelled(q, stop)) return false;
+    if (!fs::remove(*it, ec) && ec) {
+      FileOpError(q, *it, "remove", ec.value());
+      return false;
+    }
+    ++q.itemsDone;
+  }
+
+  return true;
+}
+
+void RunFileOp(FileOpQueue& q, stop_token const& stop, FileOp const& op) {
+  switch (op.kind) {
+    case FileOp_Copy: {
+      CopyTree(q, stop, op.src, op.dst);
+    } break;
+    case FileOp_Delete: {
+      DeleteTree(q, stop, op.src);
+    } break;
+    case FileOp_Move:
+    case FileOp_Rename: {
+      error_code ec;
+      if (fs::exists(fs::symlink_status(op.dst, ec))) {
+        FileOpError(q, op.dst, "rename", EEXIST);
+        break;
+      }
+      q.itemsTotal = 1;
+      if (rename(op.src.c_str(), op.dst.c_str()) == 0) {
+        ++q.itemsDone;
+        if (op.kind == FileOp_Rename) {
+          lock_guard l(q.lock);
+          q.renamed.push_back(op);
+        }
+      } else if (errno == EXDEV && op.kind == FileOp_Move) {
+        // Cross-filesystem move: copy, then delete the source only if the copy completed.
+        if (CopyTree(q, stop, op.src, op.dst) && !FileOpCancelled(q, stop)) {
+          q.itemsDone = 0;
+          q.bytesTotal = 0;
+          DeleteTree(q, stop, op.src);
+        }
+      } else {
+        FileOpError(q, op.src, "rename", errno);
+      }
+    } break;
+  }
+}
+
+void FileOpWorker(stop_token stop, FileOpQueue& q) {
+  while (true) {
+    FileOp op;
+    {
+      unique_lock l(q.lock);
+      if (!q.wakeup.wait(l, stop, [&] { return !q.pending.empty(); })) return;
+      op = std::move(q.pending.front());
+      q.pending.pop_front();
+      q.current = op.src.filename().string();
+      q.cancel = false;
+      q.busy = true;
+    }
+
+    q.bytesDone = 0;
+    q.bytesTotal = 0;
+    q.itemsDone = 0;
+    q.itemsTotal = 0;
+
+    RunFileOp(q, stop, op);
+
+    lock_guard l(q.lock);
+    q.current.clear();
+    q.busy = false;
+  }
+}
+
+void PushFileOp(App& app, FileOpKind kind, fs::path const& src, fs::path const& dst = {}) {
+  {
+    lock_guard l(app.ops->lock);
+    app.ops->pending.push_back(FileOp { kind, src, dst });
+  }
+  app.ops->wakeup.notify_one();
+}
+
+void CancelFileOps(App& app) {
+  lock_guard l(app.ops->lock);
+  app.ops->pending.clear();
+  app.ops->cancel = true;
+}
+
+bool IsWithin(fs::path const& path, fs::path const& root) {
+  error_code ec;
+  fs::path canonicalPath = fs::weakly_canonical(path, ec);
+  fs::path canonicalRoot = fs::weakly_canonical(root, ec);
+  auto [rootIt, pathIt] = mismatch(canonicalRoot.begin(), canonicalRoot.end(), canonicalPath.begin(), canonicalPath.end());
+  return rootIt == canonicalRoot.end();
+}
+
+void PasteClipboard(App& app) {
+  for (auto const& path : app.clipboard) {
+    fs::path dst = app.cwd / path.filename();
+    if (IsWithin(dst, path) && IsWithin(path, dst)) {
+      FileOpError(*app.ops, path, "paste", "already in this directory");
+      continue;
+    }
+    // Copying a directory into its own subtree would recurse into the copy.
+    if (IsWithin(dst, path)) {
+      FileOpError(*app.ops, path, "paste", EINVAL);
+      continue;
+    }
+    PushFileOp(app, app.clipboardIsCut ? FileOp_Move : FileOp_Copy, path, dst);
+  }
+  if (app.clipboardIsCut) app.clipboard.clear();
+}
+
+int64_t FileMTime(struct stat const& st) {
+  return (int64_t)st.st_mtim.tv_sec*1000000000 + st.st_mtim.tv_nsec;
+}
+
+bool LooksBinary(const char* bytes, size_t size) {
+  size_t controlCount = 0;
+  for (size_t i = 0; i < size; ++i) {
+    unsigned char c = bytes[i];
+    if (c == 0) return true;
+    if (c < 32 && c != '\n' && c != '\r' && c != '\t') ++controlCount;
+  }
+  return controlCount*10 > size;
+}
+
+void HexDump(string& out, const unsigned char* bytes, size_t size) {
+  char line[96] = {};
+  for (size_t offset = 0; offset < size; offset += 16) {
+    int n = snprintf(line, sizeof(line), "%08zx  ", offset);
+    for (size_t i = 0; i < 16; ++i) {
+      if (offset + i < size) n += snprintf(line + n, sizeof(line) - n, "%02x ", bytes[offset + i]);
+      else n += snprintf(line + n, sizeof(line) - n, "   ");
+    }
+    line[n++] = ' ';
+    for (size_t i = 0; i < 16 && offset + i < size; ++i) {
+      unsigned char c = bytes[offset + i];
+      line[n++] = (c >= 32 && c < 127) ? c : '.';
+    }
+    line[n++] = '\n';
+    out.append(line, n);
+  }
+}
+
+// Box-filters a Paint canvas down to a thumbnail, one strip of source rows at
+// a time so a stale request can bail out between reads. A failed read sets
+// errno, to EIO when the file came up short.
+bool ReadCanvasThumbnail(int fd, vector<uint32_t>& pixels, function<bool()> const& stale) {
+  constexpr size_t STRIP_SIZE = THUMBNAIL_SCALE*PAINT_CANVAS_WIDTH*4;
+  vector<unsigned char> strip(STRIP_SIZE);
+  pixels.assign(THUMBNAIL_WIDTH*THUMBNAIL_HEIGHT, 0);
+
+  for (size_t ty = 0; ty < THUMBNAIL_HEIGHT; ++ty) {
+    if (stale()) return false;
+    ssize_t n = pread(fd, strip.data(), STRIP_SIZE, ty*STRIP_SIZE);
+    if (n != (ssize_t)STRIP_SIZE) {
+      if (n != -1) errno = EIO;
+      return false;
+    }
+
+    for (size_t tx = 0; tx < THUMBNAIL_WIDTH; ++tx) {
+      uint32_t sum[4] = {};
+      for (size_t y = 0; y < THUMBNAIL_SCALE; ++y) {
+        for (size_t x = 0; x < THUMBNAIL_SCALE; ++x) {
+          const unsigned char* px = &strip[(y*PAINT_CANVAS_WIDTH + tx*THUMBNAIL_SCALE + x)*4];
+          for (int c = 0; c < 4; ++c) sum[c] += px[c];
+        }
+      }
+      constexpr uint32_t N = THUMBNAIL_SCALE*THUMBNAIL_SCALE;
+      pixels[ty*THUMBNAIL_WIDTH + tx] = IM_COL32(sum[0]/N, sum[1]/N, sum[2]/N, sum[3]/N);
+    }
+  }
+
+  return true;
+}
+
+shared_ptr<Preview> BuildPreview(fs::path const& path, function<bool()> const& stale) {
+  auto preview = make_shared<Preview>();
+  preview->path = path;
+  preview->kind = Preview_Error;
+
+  struct stat st = {};
+  if (stat(path.c_str(), &st) == -1) {
+    preview->text = strerror(errno);
+    return preview;
+  }
+  preview->mtime = FileMTime(st);
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    preview->text = strerror(errno);
+    return preview;
+  }
+
+  if (path.extension() == ".bin" && (size_t)st.st_size == PAINT_CANVAS_WIDTH*PAINT_CANVAS_HEIGHT*4) {
+    if (ReadCanvasThumbnail(fd, preview->pixels, stale)) {
+      preview->kind = Preview_Canvas;
+    } else if (stale()) {
+      preview = nullptr;
+    } else {
+      preview->text = strerror(errno);
+      preview->pixels = {};
+    }
+    close(fd);
+    return preview;
+  }
+
+  char head[PREVIEW_TEXT_BYTES];
+  ssize_t n = pread(fd, head, sizeof(head), 0);
+  close(fd);
+  if (n == -1) {
+    preview->text = strerror(errno);
+    return preview;
+  }
+
+  if (LooksBinary(head, n)) {
+    preview->kind = Preview_Hex;
+    HexDump(preview->text, (const unsigned char*)head, min((size_t)n, PREVIEW_HEX_BYTES));
+  } else {
+    preview->kind = Preview_Text;
+    preview->text.assign(head, n);
+  }
+  preview->text.shrink_to_fit();
+
+  return preview;
+}
+
+void PreviewWorker(stop_token stop, PreviewCache& cache) {
+  uint64_t handled = 0;
+  while (true) {
+    fs::path path;
+    uint64_t generation = 0;
+    {
+      unique_lock l(cache.lock);
+      if (!cache.wakeup.wait(l, stop, [&] { return cache.generation != handled; })) return;
+      path = cache.wanted;
+      generation = handled = cache.generation;
+    }
+
+    auto stale = [&] { return cache.generation != generation || stop.stop_requested(); };
+    shared_ptr<Preview> preview = BuildPreview(path, stale);
+    if (!preview || stale()) continue;
+
+    lock_guard l(cache.lock);
+    if (auto it = cache.index.find(path.native()); it != cache.index.end()) {
+      cache.memory -= PreviewMemory(**it->second);
+      cache.lru.erase(it->second);
+    }
+    cache.lru.push_front(preview);
+    cache.index[path.native()] = cache.lru.begin();
+    cache.memory += PreviewMemory(*preview);
+
+    while (cache.memory > PREVIEW_CACHE_BUDGET && cache.lru.size() > 1) {
+      auto& victim = cache.lru.back();
+      cache.memory -= PreviewMemory(*victim);
+      cache.index.erase(victim->path.native());
+      cache.lru.pop_back();
+    }
+  }
+}
+
+// Returns the cached preview for path, or asks the worker for it and returns
+// null. Only called when the selection changes or a request is in flight.
+shared_ptr<Preview> RequestPreview(PreviewCache& cache, fs::path const& path) {
+  struct stat st = {};
+  if (stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode)) return nullptr;
+
+  lock_guard l(cache.lock);
+  if (auto it = cache.index.find(path.native()); it != cache.index.end()) {
+    if ((*it->second)->mtime == FileMTime(st)) {
+      cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+      return *it->second;
+    }
+  }
+
+  // Compare the mtime too: reselecting a file that changed since it was last
+  // requested must ask again, even though wanted still names it.
+  if (cache.wanted != path || cache.wantedMTime != FileMTime(st)) {
+    cache.wanted = path;
+    cache.wantedMTime = FileMTime(st);
+    ++cache.generation;
+    cache.wakeup.notify_one();
+  }
+  return nullptr;
+}
+
+void UploadThumbnail(App& app, Preview const& preview) {
+  if (!app.previewTexture) {
+    glGenTextures(1, &app.previewTexture);
+    glBindTexture(GL_TEXTURE_2D, app.previewTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  glBindTexture(GL_TEXTURE_2D, app.previewTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, preview.pixels.data());
+}
+
+void PreviewPane(App& app) {
+  bool isFile = app.selection.size() <= 1 && !app.selectedPath.empty();
+  if (!isFile) {
+    app.preview = nullptr;
+    ImGui::TextDisabled("No preview.");
+    return;
+  }
+
+  if (!app.preview || app.preview->path != app.selectedPath) {
+    app.preview = RequestPreview(*app.previews, app.selectedPath);
+    if (app.preview && app.preview->kind == Preview_Canvas) {
+      UploadThumbnail(app, *app.preview);
+    }
+  }
+
+  if (!app.preview) {
+    ImGui::TextDisabled(fs::is_directory(app.selectedPath) ? "No preview." : "Loading preview...");
+    return;
+  }
+
+  switch (app.preview->kind) {
+    case Preview_Text:
+    case Preview_Hex: {
+      ImGui::TextUnformatted(app.preview->text.data(), app.preview->text.data() + app.preview->text.size());
+    } break;
+    case Preview_Canvas: {
+      ImGui::Image((ImTextureID)(intptr_t)app.previewTexture, ImVec2((float)THUMBNAIL_WIDTH, (float)THUMBNAIL_HEIGHT));
+    } break;
+    case Preview_Error: {
+      ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Can't preview: %s", app.preview->text.c_str());
+    } break;
+  }
+}
+
+TreeNode* AllocTreeNode(TreeNodePool& pool, TreeNode* parent, const char* name) {
+  if (!pool.freeList) {
+    auto block = make_unique<TreeNode[]>(TREE_POOL_BLOCK_SIZE);
+    for (size_t i = 0; i < TREE_POOL_BLOCK_SIZE; ++i) {
+      block[i].nextSibling = pool.freeList;
+      pool.freeList = &block[i];
+    }
+    pool.blocks.push_back(std::move(block));
+  }
+
+  TreeNode* node = pool.freeList;
+  pool.freeList = node->nextSibling;
+  ++pool.liveCount;
+
+  *node = {};
+  node->parent = parent;
+  node->serial = ++pool.nextSerial;
+  strncpy(node->name, name, sizeof(node->name) - 1);
+  return node;
+}
+
+// Returns every descendant of node to the pool and marks node unloaded, so
+// the next time it is opened its children are enumerated again.
+void FreeTreeChildren(TreeNodePool& pool, TreeNode* node) {
+  vector<TreeNode*> stack;
+  for (TreeNode* child = node->firstChild; child; child = child->nextSibling) stack.push_back(child);
+
+  while (!stack.empty()) {
+    TreeNode* n = stack.back();
+    stack.pop_back();
+    for (TreeNode* child = n->firstChild; child; child = child->nextSibling) stack.push_back(child);
+
+    n->serial = 0;
+    n->nextSibling = pool.freeList;
+    pool.freeList = n;
+    --pool.liveCount;
+  }
+
+  node->firstChild = nullptr;
+  node->state = TreeNode_Unloaded;
+}
+
+fs::path TreeNodePath(TreeNode const* node) {
+  vector<const char*> names;
+  for (; node; node = node->parent) names.push_back(node->name);
+
+  fs::path path;
+  for (auto it = names.rbegin(); it != names.rend(); ++it) path /= *it;
+  return path;
+}
+
+void TreeLoaderWorker(stop_token stop, TreeLoader& loader) {
+  while (true) {
+    TreeExpandJob job;
+    {
+      unique_lock l(loader.lock);
+      if (!loader.wakeup.wait(l, stop, [&] { return !loader.jobs.empty(); })) return;
+      job = std::move(loader.jobs.front());
+      loader.jobs.pop_front();
+    }
+
+    TreeExpandResult result = { job.node, job.serial, {} };
+    error_code ec;
+    for (const auto& entry : fs::directory_iterator(job.path, ec)) {
+      if (stop.stop_requested()) return;
+      if (entry.is_directory(ec)) result.names.push_back(entry.path().filename().string());
+    }
+    sort(result.names.begin(), result.names.end());
+
+    lock_guard l(loader.lock);
+    loader.results.push_back(std::move(result));
+  }
+}
+
+void RequestTreeExpand(App& app, TreeNode* node) {
+  node->state = TreeNode_Loading;
+  {
+    lock_guard l(app.treeLoader->lock);
+    app.treeLoader->jobs.push_back(TreeExpandJob { node, node->serial, TreeNodePath(node) });
+  }
+  app.treeLoader->wakeup.notify_one();
+}
+
+void ApplyTreeExpandResults(App& app) {
+  vector<TreeExpandResult> results;
+  {
+    lock_guard l(app.treeLoader->lock);
+    results.swap(app.treeLoader->results);
+  }
+
+  for (auto& result : results) {
+    // The node may have been evicted, and maybe reused, while loading.
+    TreeNode* node = result.node;
+    if (node->serial != result.serial || node->state != TreeNode_Loading) continue;
+
+    TreeNode** link = &node->firstChild;
+    for (auto const& name : result.names) {
+      *link = AllocTreeNode(app.treePool, node, name.c_str());
+      link = &(*link)->nextSibling;
+    }
+    node->state = TreeNode_Loaded;
+  }
+}
+
+// Collapsed subtrees are invisible, so once the pool grows past its budget
+// the ones that were closed longest ago are dropped first.
+void EvictTreeNodes(App& app, int frame) {
+  if (app.treePool.liveCount <= TREE_NODE_BUDGET) return;
+
+  vector<TreeNode*> collapsed;
+  vector<TreeNode*> stack;
+  if (app.treeRoot->lastOpenFrame == frame) stack.push_back(app.treeRoot);
+  else collapsed.push_back(app.treeRoot);
+
+  while (!stack.empty()) {
+    TreeNode* node = stack.back();
+    stack.pop_back();
+    for (TreeNode* child = node->firstChild; child; child = child->nextSibling) {
+      if (child->lastOpenFrame == frame) stack.push_back(child);
+      else if (child->firstChild) collapsed.push_back(child);
+    }
+  }
+
+  sort(collapsed.begin(), collapsed.end(), [](TreeNode* a, TreeNode* b) { return a->lastOpenFrame < b->lastOpenFrame; });
+  for (TreeNode* node : collapsed) {
+    if (app.treePool.liveCount <= TREE_NODE_BUDGET*3/4) break;
+    FreeTreeChildren(app.treePool, node);
+  }
+}
+
+void DrawTreeNode(App& app, TreeNode* node, int frame) {
+  auto flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_OpenOnDoubleClick | ImGuiTreeNodeFlags_SpanAvailWidth;
+  if (node->state == TreeNode_Loaded && !node->firstChild) flags |= ImGuiTreeNodeFlags_Leaf;
+  if (node == app.treeSelected && node->serial == app.treeSelectedSerial) flags |= ImGuiTreeNodeFlags_Selected;
+
+  // Keyed by serial rather than address, so a recycled node doesn't inherit
+  // the open state of the directory that used its slot before.
+  bool open = ImGui::TreeNodeEx((void*)(uintptr_t)node->serial, flags, "%s", node->name);
+  if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
+    app.treeSelected = node;
+    app.treeSelectedSerial = node->serial;
+    app.cwd = TreeNodePath(node);
+    app.selection.clear();
+  }
+
+  if (!open) return;
+
+  node->lastOpenFrame = frame;
+  if (node->state == TreeNode_Unloaded) RequestTreeExpand(app, node);
+  if (node->state == TreeNode_Loading) ImGui::TextDisabled("Loading...");
+
+  for (TreeNode* child = node->firstChild; child; child = child->nextSibling) {
+    DrawTreeNode(app, child, frame);
+  }
+  ImGui::TreePop();
+}
+
+void TreePanel(App& app) {
+  int frame = ImGui::GetFrameCount();
+
+  ApplyTreeExpandResults(app);
+  ImGui::SetNextItemOpen(true, ImGuiCond_Once);
+  DrawTreeNode(app, app.treeRoot, frame);
+  EvictTreeNodes(app, frame);
+}
+
 void RenameFilePopup(App& app) {
   ImGui::OpenPopup("Rename File");
   if (ImGui::BeginPopupModal("Rename File")) {
@@ -20,12 +854,11 @@ void RenameFilePopup(App& app) {
     ImGui::InputText("###newName", filenameBuffer, sizeof(filenameBuffer));
 
     fs::path newPath = app.selectedPath.parent_path() / filenameBuffer;
-    if (ImGui::Button("Rename")) {
-      if (rename(app.selectedPath.string().c_str(), newPath.string().c_str()) == 0) {
-        app.selectedPath = newPath;
-        app.shouldShowRenamePopup = false;
-        memset(filenameBuffer, 0, sizeof(filenameBuffer));
-      }
+    if (ImGui::Button("Rename") && filenameBuffer[0]) {
+      // The selection follows once the rename is done, see Operations.
+      PushFileOp(app, FileOp_Rename, app.selectedPath, newPath);
+      app.shouldShowRenamePopup = false;
+      memset(filenameBuffer, 0, sizeof(filenameBuffer));
     }
 
     ImGui::SameLine();
@@ -39,16 +872,29 @@ void RenameFilePopup(App& app) {
   }
 }
 
+// The multi-selection, or the single selected path when there is none.
+vector<fs::path> SelectedPaths(App const& app) {
+  if (app.selection.empty()) return { app.selectedPath };
+  return { app.selection.begin(), app.selection.end() };
+}
+
 void DeleteFilePopup(App& app) {
   ImGui::OpenPopup("Delete File");
   if (ImGui::BeginPopupModal("Delete File")) {
-    ImGui::Text("Are you sure you want to delete %s?", app.selectedPath.filename().string().c_str());
+    vector<fs::path> targets = SelectedPaths(app);
+    if (targets.size() > 1) {
+      ImGui::Text("Are you sure you want to delete %zu items?", targets.size());
+    } else {
+      ImGui::Text("Are you sure you want to delete %s?", targets[0].filename().string().c_str());
+    }
 
     if (ImGui::Button("Yes")) {
-      if (fs::remove(app.selectedPath.string().c_str())) {
-        app.selectedPath.clear();
-        app.shouldShowDeletePopup = false;
+      for (auto const& path : targets) {
+        PushFileOp(app, FileOp_Delete, path);
       }
+      app.selection.clear();
+      app.selectedPath.clear();
+      app.shouldShowDeletePopup = false;
     }
 
     ImGui::SameLine();
@@ -76,6 +922,7 @@ void Menu(App& app) {
   if (ImGui::Button("Go Up")) {
     if (app.cwd.has_parent_path()) {
       app.cwd = app.cwd.parent_path();
+      app.selection.clear();
     }
   }
 
@@ -84,10 +931,18 @@ void Menu(App& app) {
 }
 
 void Content(App& app) {
-  for (const auto& entry : fs::directory_iterator(app.cwd)) {
-    bool isDirectory = entry.is_directory();
-    bool isFile = entry.is_regular_file();
-    bool isSelected = entry.path() == app.selectedPath;
+  fs::path previousPath, nextPath;
+  bool passedSelection = false;
+
+  error_code ec;
+  for (const auto& entry : fs::directory_iterator(app.cwd, ec)) {
+    if (entry.path() == app.selectedPath) passedSelection = true;
+    else if (!passedSelection) previousPath = entry.path();
+    else if (nextPath.empty()) nextPath = entry.path();
+
+    bool isDirectory = entry.is_directory(ec);
+    bool isFile = entry.is_regular_file(ec);
+    bool isSelected = app.selection.contains(entry.path());
 
     string entryName = "";
     if (isDirectory) {
@@ -97,21 +952,57 @@ void Content(App& app) {
     }
 
     if (ImGui::Selectable(entryName.c_str(), isSelected)) {
-      app.selectedPath = entry.path();
-      if (isDirectory) {
-        app.cwd /= app.selectedPath;
+      if (ImGui::GetIO().KeyCtrl) {
+        // Ctrl+click toggles the entry in the multi-selection, directories
+        // included. selectedPath must stay inside the selection, or the
+        // delete popup would name a file other than the ones it deletes.
+        if (isSelected) {
+          app.selection.erase(entry.path());
+          if (app.selection.empty()) app.selectedPath.clear();
+          else app.selectedPath = *app.selection.begin();
+        } else {
+          app.selection.insert(entry.path());
+          app.selectedPath = entry.path();
+        }
+      } else {
+        app.selectedPath = entry.path();
+        app.selection = { entry.path() };
+        if (isDirectory) {
+          app.cwd /= app.selectedPath;
+          app.selection.clear();
+        }
       }
     }
   }
+
+  // Arrow keys walk the selection so the preview pane follows along.
+  if (ImGui::IsWindowFocused()) {
+    fs::path target;
+    if (ImGui::IsKeyPressed(ImGuiKey_UpArrow) && !previousPath.empty()) target = previousPath;
+    if (ImGui::IsKeyPressed(ImGuiKey_DownArrow) && !nextPath.empty()) target = nextPath;
+    if (!target.empty()) {
+      app.selectedPath = target;
+      app.selection = { target };
+    }
+  }
 }
 
 void Actions(App& app) {
-  if (fs::is_directory(app.selectedPath)) {
+  if (app.selection.size() > 1) {
+    ImGui::Text("Selected %zu items", app.selection.size());
+  } else if (fs::is_directory(app.selectedPath)) {
     ImGui::Text("Selected Directory: %s", app.selectedPath.string().c_str());
   } else if (fs::is_regular_file(app.selectedPath)) {
     ImGui::Text("Selected File: %s", app.selectedPath.string().c_str());
   } else {
     ImGui::Text("Nothing Selected!");
+    if (!app.clipboard.empty()) {
+      ImGui::SameLine();
+      if (ImGui::Button("Paste")) {
+        PasteClipboard(app);
+      }
+      return;
+    }
     // Draw invisible button to add Y offset
     ImGui::PushStyleVar(ImGuiStyleVar_Alpha, 0.0f);
     ImGui::Button("invisible button");
@@ -136,15 +1027,77 @@ void Actions(App& app) {
     app.shouldShowDeletePopup = true;
     DeleteFilePopup(app);
   }
+
+  ImGui::SameLine();
+
+  bool copy = ImGui::Button("Copy");
+  ImGui::SameLine();
+  bool cut = ImGui::Button("Cut");
+  if (copy || cut) {
+    app.clipboard = SelectedPaths(app);
+    app.clipboardIsCut = cut;
+  }
+
+  if (!app.clipboard.empty()) {
+    ImGui::SameLine();
+    char label[64] = {};
+    snprintf(label, sizeof(label) - 1, "Paste %zu item(s)", app.clipboard.size());
+    if (ImGui::Button(label)) {
+      PasteClipboard(app);
+    }
+  }
+}
+
+void Operations(App& app) {
+  FileOpQueue& q = *app.ops;
+
+  string current, lastError;
+  size_t pendingCount = 0;
+  vector<FileOp> renamed;
+  {
+    lock_guard l(q.lock);
+    current = q.current;
+    lastError = q.lastError;
+    pendingCount = q.pending.size();
+    renamed.swap(q.renamed);
+  }
+
+  for (FileOp const& op : renamed) {
+    if (app.selectedPath == op.src) app.selectedPath = op.dst;
+    if (app.selection.erase(op.src)) app.selection.insert(op.dst);
+  }
+
+  if (!q.busy && pendingCount == 0) {
+    if (!lastError.empty()) {
+      ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Last error: %s", lastError.c_str());
+    } else {
+      ImGui::Text("No pending operations.");
+    }
+    return;
+  }
+
+  // Copies report bytes, deletes and renames report entries.
+  float fraction = 0.0f;
+  if (q.bytesTotal > 0) fraction = (float)q.bytesDone / (float)q.bytesTotal;
+  else if (q.itemsTotal > 0) fraction = (float)q.itemsDone / (float)q.itemsTotal;
+
+  char overlay[256] = {};
+  snprintf(overlay, sizeof(overlay) - 1, "%s (%zu pending)", current.c_str(), pendingCount);
+  ImGui::ProgressBar(fraction, ImVec2(app.w * 0.5f, 0.0f), overlay);
+  ImGui::SameLine();
+  if (ImGui::Button("Cancel")) {
+    CancelFileOps(app);
+  }
 }
 
 void Filter(App& app) {
   ImGui::InputText("Filter by Extension", app.extensionFilter, sizeof(app.extensionFilter));
 
   int matchCount = 0;
+  error_code ec;
   if (strlen(app.extensionFilter) > 0)
-    for (const auto& entry : fs::directory_iterator(app.cwd))
-      if (entry.is_regular_file())
+    for (const auto& entry : fs::directory_iterator(app.cwd, ec))
+      if (entry.is_regular_file(ec))
         if (entry.path().extension().string() == app.extensionFilter)
           ++matchCount;
 
@@ -156,6 +1109,16 @@ void AppInit(App& app, float w, float h) {
     app.w = w;
     app.h = h;
     app.cwd = fs::current_path();
+
+    app.ops = make_unique<FileOpQueue>();
+    app.ops->worker = jthread(FileOpWorker, std::ref(*app.ops));
+
+    app.previews = make_unique<PreviewCache>();
+    app.previews->worker = jthread(PreviewWorker, std::ref(*app.previews));
+
+    app.treeRoot = AllocTreeNode(app.treePool, nullptr, "/");
+    app.treeLoader = make_unique<TreeLoader>();
+    app.treeLoader->worker = jthread(TreeLoaderWorker, std::ref(*app.treeLoader));
 }
 
 void AppUpdateAndRender(App& app) {
@@ -166,13 +1129,25 @@ void AppUpdateAndRender(App& app) {
 
     Menu(app);
     ImGui::Separator();
+    float footerY = ImGui::GetWindowHeight() - 130.0f;
+    float paneHeight = footerY - ImGui::GetCursorPosY() - ImGui::GetStyle().ItemSpacing.y;
+    ImGui::BeginChild("##tree", ImVec2(app.w * 0.25f, paneHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+    TreePanel(app);
+    ImGui::EndChild();
+    ImGui::SameLine();
+    ImGui::BeginChild("##content", ImVec2(app.w * 0.4f, paneHeight), true);
     Content(app);
-    ImGui::SetCursorPosY(ImGui::GetWindowHeight() - 100.0f);
+    ImGui::EndChild();
+    ImGui::SameLine();
+    ImGui::BeginChild("##preview", ImVec2(0.0f, paneHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+    PreviewPane(app);
+    ImGui::EndChild();
+    ImGui::SetCursorPosY(footerY);
     ImGui::Separator();
     Actions(app);
+    Operations(app);
     ImGui::Separator();
     Filter(app);
 
     ImGui::End();
 }
-
@@ -1,7 +1,36 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cfloat>
 #include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <variant>
 #include <vector>
 
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "implot.h"
 
 enum FunctionId {
@@ -9,41 +38,1514 @@ enum FunctionId {
   Sin,
   Cos,
   Sq,
+  Expression,
+};
+
+size_t ThreadCount() {
+  return max(1u, thread::hardware_concurrency());
+}
+
+template <typename F>
+void ParallelFor(size_t count, F const& body) {
+  vector<jthread> threads;
+  for (size_t i = 1; i < count; ++i) threads.emplace_back([&body, i] { body(i); });
+  if (count > 0) body(0);
+}
+
+#ifdef __SSE2__
+// Four-wide sinf/cosf after Cephes: reduce by multiples of pi/4 in three
+// parts for precision, then pick the sine or cosine polynomial per lane.
+// Accurate to a few ulp for |x| up to about 8192.
+struct SinCosReduced {
+  __m128 x, z;
+  __m128i octant;
+};
+
+inline SinCosReduced ReduceSinCos(__m128 x) {
+  __m128 y = _mm_mul_ps(x, _mm_set1_ps(1.27323954473516f));  // 4/pi
+  __m128i octant = _mm_and_si128(_mm_add_epi32(_mm_cvttps_epi32(y), _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+  y = _mm_cvtepi32_ps(octant);
+  x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+  x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+  x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+  return { x, _mm_mul_ps(x, x), octant };
+}
+
+inline __m128 SinCosPolynomial(SinCosReduced r, __m128i usesSine, __m128 signBits) {
+  __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), r.z), _mm_set1_ps(-1.388731625493765e-3f));
+  c = _mm_add_ps(_mm_mul_ps(c, r.z), _mm_set1_ps(4.166664568298827e-2f));
+  c = _mm_mul_ps(_mm_mul_ps(c, r.z), r.z);
+  c = _mm_sub_ps(c, _mm_mul_ps(r.z, _mm_set1_ps(0.5f)));
+  c = _mm_add_ps(c, _mm_set1_ps(1.0f));
+
+  __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), r.z), _mm_set1_ps(8.3321608736e-3f));
+  s = _mm_add_ps(_mm_mul_ps(s, r.z), _mm_set1_ps(-1.6666654611e-1f));
+  s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, r.z), r.x), r.x);
+
+  __m128 mask = _mm_castsi128_ps(usesSine);
+  __m128 y = _mm_or_ps(_mm_and_ps(mask, s), _mm_andnot_ps(mask, c));
+  return _mm_xor_ps(y, signBits);
+}
+
+inline __m128 SinPs(__m128 x) {
+  __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  __m128 sign = _mm_and_ps(x, signMask);
+  SinCosReduced r = ReduceSinCos(_mm_andnot_ps(signMask, x));
+  __m128 flip = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(r.octant, _mm_set1_epi32(4)), 29));
+  __m128i usesSine = _mm_cmpeq_epi32(_mm_and_si128(r.octant, _mm_set1_epi32(2)), _mm_setzero_si128());
+  return SinCosPolynomial(r, usesSine, _mm_xor_ps(sign, flip));
+}
+
+inline __m128 CosPs(__m128 x) {
+  SinCosReduced r = ReduceSinCos(_mm_andnot_ps(_mm_castsi128_ps(_mm_set1_epi32(0x80000000)), x));
+  __m128i octant = _mm_sub_epi32(r.octant, _mm_set1_epi32(2));
+  __m128 sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(octant, _mm_set1_epi32(4)), 29));
+  __m128i usesSine = _mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128());
+  return SinCosPolynomial(r, usesSine, sign);
+}
+
+// Four-wide expf, also after Cephes: x = n*ln2 + r with |r| <= ln2/2, a
+// polynomial for e^r, and 2^n built in the exponent bits. NaN stays NaN.
+inline __m128 ExpPs(__m128 x) {
+  __m128 nan = _mm_cmpunord_ps(x, x);
+  x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(88.3762626647949f)), _mm_set1_ps(-88.3762626647949f));
+  __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+  __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+  fx = _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, fx), _mm_set1_ps(1.0f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+  __m128 z = _mm_mul_ps(x, x);
+  __m128 y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(1.9875691500e-4f), x), _mm_set1_ps(1.3981999507e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+  y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), _mm_set1_ps(1.0f));
+
+  __m128i n = _mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f));
+  __m128 pow2n = _mm_castsi128_ps(_mm_slli_epi32(n, 23));
+  return _mm_or_ps(_mm_mul_ps(y, pow2n), nan);
+}
+#endif
+
+template <FunctionId id, typename T>
+T EvalFunction(T x) {
+  if constexpr (id == Sin) return sin(x);
+  if constexpr (id == Cos) return cos(x);
+  if constexpr (id == Sq) return x*x;
+  return 0;
+}
+
+// Writes samples [begin, end) of x = start + i*step: ys gets f(x) and xs
+// the offset i*step, which unlike x itself stays exact in T however far
+// start is from zero. Float samples go four at a time, each block getting
+// its first x in double.
+template <FunctionId id, typename T>
+void SampleFunction(double start, double step, size_t begin, size_t end, T* xs, T* ys) {
+  size_t i = begin;
+#ifdef __SSE2__
+  if constexpr (is_same_v<T, float>) {
+    __m128 lanes = _mm_mul_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps((float)step));
+    for (; i + 4 <= end; i += 4) {
+      __m128 x = _mm_add_ps(_mm_set1_ps((float)(start + (double)i*step)), lanes);
+      __m128 y;
+      if constexpr (id == Sin) y = SinPs(x);
+      else if constexpr (id == Cos) y = CosPs(x);
+      else y = _mm_mul_ps(x, x);
+      _mm_storeu_ps(xs + i, _mm_add_ps(_mm_set1_ps((float)((double)i*step)), lanes));
+      _mm_storeu_ps(ys + i, y);
+    }
+  }
+#endif
+  for (; i < end; ++i) {
+    xs[i] = (T)((double)i*step);
+    ys[i] = EvalFunction<id>((T)(start + (double)i*step));
+  }
+}
+
+// Samples count points from start into preallocated xs/ys. Large counts
+// are split across threads in slices of whole SIMD blocks.
+template <typename T, typename Kernel>
+void SamplePoints(Kernel const& kernel, double start, double step, size_t count, T* xs, T* ys) {
+  size_t sliceCount = max((size_t)1, min(ThreadCount(), count / (1 << 16)));
+  ParallelFor(sliceCount, [&](size_t slice) {
+    size_t begin = (count*slice/sliceCount) & ~(size_t)3;
+    size_t end = slice + 1 == sliceCount ? count : (count*(slice + 1)/sliceCount) & ~(size_t)3;
+    kernel(start, step, begin, end, xs, ys);
+  });
+}
+
+enum ExprOp : uint8_t {
+  Expr_X,
+  Expr_Const,
+  Expr_Neg,
+  Expr_Add,
+  Expr_Sub,
+  Expr_Mul,
+  Expr_Div,
+  Expr_Pow,
+  Expr_Sin,
+  Expr_Cos,
+  Expr_Tan,
+  Expr_Exp,
+  Expr_Log,
+  Expr_Sqrt,
+  Expr_Abs,
+};
+
+constexpr size_t EXPR_BLOCK = 128;
+constexpr size_t EXPR_MAX_REGISTERS = 32;
+constexpr size_t EXPR_MAX_LENGTH = 256;
+
+struct ExprInstr {
+  ExprOp op;
+  uint8_t dst, a, b;
+};
+
+// Register 0 holds x and the constants follow it; they're written once per
+// call. The code reuses the remaining registers as soon as a value is dead,
+// and each instruction runs over a whole block of x at a time. Constants
+// are kept in double so one program serves both precisions.
+struct ExprProgram {
+  string source;
+  vector<double> constants;
+  vector<ExprInstr> code;
+  uint8_t result;
+};
+
+// The parser builds a DAG in which every node is unique: a node that is
+// already known (same op and operands) is reused rather than added again,
+// and nodes whose operands are all constant are folded on the spot.
+struct ExprNode {
+  ExprOp op;
+  uint32_t a, b;
+  double value;
+};
+
+struct ExprParser {
+  const char* begin;
+  const char* p;
+  const char* end;
+  vector<ExprNode> nodes;
+  map<tuple<ExprOp, uint32_t, uint32_t, uint64_t>, uint32_t> known;
+  char error[128];
+};
+
+bool ExprError(ExprParser& parser, const char* message) {
+  snprintf(parser.error, sizeof(parser.error), "%s at column %zu", message, parser.p - parser.begin + 1);
+  return false;
+}
+
+// Skips spaces, then consumes token if it comes next.
+bool AcceptToken(const char*& p, const char* end, string_view token) {
+  while (p < end && isspace((unsigned char)*p)) ++p;
+  if ((size_t)(end - p) < token.size() || string_view(p, token.size()) != token) return false;
+  p += token.size();
+  return true;
+}
+
+bool IsUnaryExprOp(ExprOp op) {
+  return op == Expr_Neg || op >= Expr_Sin;
+}
+
+template <typename T>
+T ApplyExprOp(ExprOp op, T a, T b) {
+  switch (op) {
+    case Expr_Neg : return -a;
+    case Expr_Add : return a + b;
+    case Expr_Sub : return a - b;
+    case Expr_Mul : return a * b;
+    case Expr_Div : return a / b;
+    case Expr_Pow : return pow(a, b);
+    case Expr_Sin : return sin(a);
+    case Expr_Cos : return cos(a);
+    case Expr_Tan : return tan(a);
+    case Expr_Exp : return exp(a);
+    case Expr_Log : return log(a);
+    case Expr_Sqrt: return sqrt(a);
+    case Expr_Abs : return fabs(a);
+    default       : return 0;
+  }
+}
+
+uint32_t PushExprNode(ExprParser& parser, ExprNode node) {
+  uint64_t bits;
+  memcpy(&bits, &node.value, sizeof(bits));
+  auto [it, inserted] = parser.known.try_emplace(tuple(node.op, node.a, node.b, bits), (uint32_t)parser.nodes.size());
+  if (inserted) parser.nodes.push_back(node);
+  return it->second;
+}
+
+uint32_t PushExprConst(ExprParser& parser, double value) {
+  return PushExprNode(parser, { Expr_Const, 0, 0, value });
+}
+
+uint32_t PushExprOp(ExprParser& parser, ExprOp op, uint32_t a, uint32_t b = 0) {
+  bool unary = IsUnaryExprOp(op);
+  if (unary) b = 0;
+  ExprNode const& lhs = parser.nodes[a];
+  ExprNode const& rhs = parser.nodes[b];
+  if (lhs.op == Expr_Const && (unary || rhs.op == Expr_Const)) return PushExprConst(parser, ApplyExprOp(op, lhs.value, rhs.value));
+
+  if (op == Expr_Pow && rhs.op == Expr_Const) {
+    if (rhs.value == 1.0) return a;
+    if (rhs.value == 2.0) return PushExprOp(parser, Expr_Mul, a, a);
+    if (rhs.value == 0.5) return PushExprOp(parser, Expr_Sqrt, a);
+  }
+  if ((op == Expr_Add || op == Expr_Mul) && a > b) swap(a, b);
+  return PushExprNode(parser, { op, a, b, 0.0 });
+}
+
+bool ParseExprSum(ExprParser& parser, uint32_t& node);
+bool ParseExprUnary(ExprParser& parser, uint32_t& node);
+
+bool ParseExprPrimary(ExprParser& parser, uint32_t& node) {
+  if (AcceptToken(parser.p, parser.end, "(")) {
+    if (!ParseExprSum(parser, node)) return false;
+    return AcceptToken(parser.p, parser.end, ")") || ExprError(parser, "expected )");
+  }
+
+  static const pair<string_view, ExprOp> functions[] = {
+    { "sin", Expr_Sin }, { "cos", Expr_Cos }, { "tan", Expr_Tan }, { "exp", Expr_Exp },
+    { "log", Expr_Log }, { "sqrt", Expr_Sqrt }, { "abs", Expr_Abs },
+  };
+  const char* q = parser.p;
+  while (q < parser.end && isalpha((unsigned char)*q)) ++q;
+  string_view name(parser.p, q - parser.p);
+  if (!name.empty()) {
+    for (auto [function, op] : functions) {
+      if (name != function) continue;
+      parser.p = q;
+      if (!AcceptToken(parser.p, parser.end, "(")) return ExprError(parser, "expected (");
+      uint32_t arg;
+      if (!ParseExprSum(parser, arg)) return false;
+      if (!AcceptToken(parser.p, parser.end, ")")) return ExprError(parser, "expected )");
+      node = PushExprOp(parser, op, arg);
+      return true;
+    }
+    if (name == "x") node = PushExprNode(parser, { Expr_X, 0, 0, 0.0 });
+    else if (name == "pi") node = PushExprConst(parser, 3.14159265358979323846);
+    else if (name == "e") node = PushExprConst(parser, 2.71828182845904523536);
+    else return ExprError(parser, "unknown name");
+    parser.p = q;
+    return true;
+  }
+
+  double number;
+  auto [ptr, ec] = from_chars(parser.p, parser.end, number);
+  if (ec != errc()) return ExprError(parser, "expected a number");
+  parser.p = ptr;
+  node = PushExprConst(parser, number);
+  return true;
+}
+
+// ^ binds tighter than unary minus and groups to the right: -x^2^3 is
+// -(x^(2^3)).
+bool ParseExprPower(ExprParser& parser, uint32_t& node) {
+  if (!ParseExprPrimary(parser, node)) return false;
+  if (!AcceptToken(parser.p, parser.end, "^")) return true;
+  uint32_t exponent;
+  if (!ParseExprUnary(parser, exponent)) return false;
+  node = PushExprOp(parser, Expr_Pow, node, exponent);
+  return true;
+}
+
+bool ParseExprUnary(ExprParser& parser, uint32_t& node) {
+  if (AcceptToken(parser.p, parser.end, "-")) {
+    if (!ParseExprUnary(parser, node)) return false;
+    node = PushExprOp(parser, Expr_Neg, node);
+    return true;
+  }
+  AcceptToken(parser.p, parser.end, "+");
+  return ParseExprPower(parser, node);
+}
+
+bool ParseExprProduct(ExprParser& parser, uint32_t& node) {
+  if (!ParseExprUnary(parser, node)) return false;
+  while (true) {
+    ExprOp op;
+    if (AcceptToken(parser.p, parser.end, "*")) op = Expr_Mul;
+    else if (AcceptToken(parser.p, parser.end, "/")) op = Expr_Div;
+    else return true;
+
+    uint32_t rhs;
+    if (!ParseExprUnary(parser, rhs)) return false;
+    node = PushExprOp(parser, op, node, rhs);
+  }
+}
+
+bool ParseExprSum(ExprParser& parser, uint32_t& node) {
+  if (!ParseExprProduct(parser, node)) return false;
+  while (true) {
+    ExprOp op;
+    if (AcceptToken(parser.p, parser.end, "+")) op = Expr_Add;
+    else if (AcceptToken(parser.p, parser.end, "-")) op = Expr_Sub;
+    else return true;
+
+    uint32_t rhs;
+    if (!ParseExprProduct(parser, rhs)) return false;
+    node = PushExprOp(parser, op, node, rhs);
+  }
+}
+
+// Parses text and lowers the live part of the DAG to register code. Nodes
+// come out of the parser in dependency order, so one forward pass can
+// hand out registers, freeing each operand after its last use.
+bool CompileExpression(string_view text, ExprProgram& program, char* error, size_t errorSize) {
+  ExprParser parser = { text.data(), text.data(), text.data() + text.size(), {}, {}, {} };
+  uint32_t root;
+  bool ok = text.size() <= EXPR_MAX_LENGTH || ExprError(parser, "expression too long");
+  ok = ok && ParseExprSum(parser, root);
+  if (ok && (AcceptToken(parser.p, parser.end, ""), parser.p != parser.end)) ok = ExprError(parser, "unexpected text");
+  if (!ok) {
+    snprintf(error, errorSize, "%s", parser.error);
+    return false;
+  }
+
+  vector<ExprNode> const& nodes = parser.nodes;
+  vector<uint32_t> lastUse(nodes.size(), 0);
+  vector<bool> live(nodes.size(), false);
+  live[root] = true;
+  for (uint32_t i = root + 1; i-- > 0;) {
+    if (!live[i] || nodes[i].op == Expr_X || nodes[i].op == Expr_Const) continue;
+    live[nodes[i].a] = true;
+    lastUse[nodes[i].a] = max(lastUse[nodes[i].a], i);
+    if (!IsUnaryExprOp(nodes[i].op)) {
+      live[nodes[i].b] = true;
+      lastUse[nodes[i].b] = max(lastUse[nodes[i].b], i);
+    }
+  }
+
+  ExprProgram result;
+  vector<uint8_t> registers(nodes.size(), 0);
+  for (uint32_t i = 0; i <= root; ++i) {
+    if (live[i] && nodes[i].op == Expr_Const) {
+      registers[i] = (uint8_t)(1 + result.constants.size());
+      result.constants.push_back(nodes[i].value);
+    }
+  }
+
+  vector<uint8_t> freeRegisters;
+  size_t registerCount = 1 + result.constants.size();
+  for (uint32_t i = 0; i <= root && registerCount <= EXPR_MAX_REGISTERS; ++i) {
+    ExprNode const& node = nodes[i];
+    if (!live[i] || node.op == Expr_X || node.op == Expr_Const) continue;
+
+    uint32_t operands[2] = { node.a, IsUnaryExprOp(node.op) ? node.a : node.b };
+    for (size_t k = 0; k < 2; ++k) {
+      ExprNode const& operand = nodes[operands[k]];
+      bool temporary = operand.op != Expr_X && operand.op != Expr_Const;
+      if (temporary && lastUse[operands[k]] == i && (k == 0 || operands[1] != operands[0])) freeRegisters.push_back(registers[operands[k]]);
+    }
+    if (freeRegisters.empty()) {
+      registers[i] = (uint8_t)registerCount++;
+    } else {
+      registers[i] = freeRegisters.back();
+      freeRegisters.pop_back();
+    }
+    result.code.push_back({ node.op, registers[i], registers[node.a], registers[operands[1]] });
+  }
+  if (registerCount > EXPR_MAX_REGISTERS) {
+    snprintf(error, errorSize, "expression too complex");
+    return false;
+  }
+
+  result.result = registers[root];
+  result.source = text;
+  program = std::move(result);
+  return true;
+}
+
+template <typename T>
+void RunExprInstr(ExprOp op, T* dst, const T* a, const T* b, size_t count) {
+  for (size_t i = 0; i < count; ++i) dst[i] = ApplyExprOp(op, a[i], b[i]);
+}
+
+#ifdef __SSE2__
+template <typename VectorOp>
+void RunExprOp(ExprOp op, float* dst, const float* a, const float* b, size_t count, VectorOp vectorOp) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) _mm_storeu_ps(dst + i, vectorOp(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  for (; i < count; ++i) dst[i] = ApplyExprOp(op, a[i], b[i]);
+}
+
+// Float blocks use the four-wide kernels where there is one.
+template <>
+void RunExprInstr<float>(ExprOp op, float* dst, const float* a, const float* b, size_t n) {
+  switch (op) {
+    case Expr_Neg: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }); break;
+    case Expr_Add: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128 b) { return _mm_add_ps(a, b); }); break;
+    case Expr_Sub: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128 b) { return _mm_sub_ps(a, b); }); break;
+    case Expr_Mul: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128 b) { return _mm_mul_ps(a, b); }); break;
+    case Expr_Div: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128 b) { return _mm_div_ps(a, b); }); break;
+    case Expr_Sin: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128) { return SinPs(a); }); break;
+    case Expr_Cos: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128) { return CosPs(a); }); break;
+    case Expr_Exp: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128) { return ExpPs(a); }); break;
+    case Expr_Sqrt: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128) { return _mm_sqrt_ps(a); }); break;
+    case Expr_Abs: RunExprOp(op, dst, a, b, n, [](__m128 a, __m128) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }); break;
+    default:
+      for (size_t i = 0; i < n; ++i) dst[i] = ApplyExprOp(op, a[i], b[i]);
+  }
+}
+#endif
+
+// Evaluates the program for count values of x. Registers live on the stack,
+// so this allocates nothing and may run on many threads at once.
+template <typename T>
+void EvaluateExpression(ExprProgram const& program, const T* xs, T* ys, size_t count) {
+  alignas(16) T registers[EXPR_MAX_REGISTERS][EXPR_BLOCK];
+  for (size_t k = 0; k < program.constants.size(); ++k) fill_n(registers[1 + k], min(count, EXPR_BLOCK), (T)program.constants[k]);
+
+  for (size_t base = 0; base < count; base += EXPR_BLOCK) {
+    size_t n = min(EXPR_BLOCK, count - base);
+    memcpy(registers[0], xs + base, n*sizeof(T));
+    for (ExprInstr const& instr : program.code) {
+      RunExprInstr<T>(instr.op, registers[instr.dst], registers[instr.a], registers[instr.b], n);
+    }
+    memcpy(ys + base, registers[program.result], n*sizeof(T));
+  }
+}
+
+// Same contract as SampleFunction.
+template <typename T>
+void SampleExpression(ExprProgram const& program, double start, double step, size_t begin, size_t end, T* xs, T* ys) {
+  T x[EXPR_BLOCK];
+  for (size_t base = begin; base < end; base += EXPR_BLOCK) {
+    size_t n = min(EXPR_BLOCK, end - base);
+    for (size_t i = 0; i < n; ++i) {
+      xs[base + i] = (T)((double)(base + i)*step);
+      x[i] = (T)(start + (double)(base + i)*step);
+    }
+    EvaluateExpression(program, x, ys + base, n);
+  }
+}
+
+constexpr size_t TILE_SAMPLES = 256;
+constexpr size_t TILE_CACHE_SIZE = 64;
+constexpr int MAX_REFINE_DEPTH = 4;
+
+// Samples are taken on a grid of spacing 2^xLevel, about one per pixel, and
+// grouped in tiles of TILE_SAMPLES grid steps. The grid is global, so once
+// a tile is sampled panning reuses it, and zooming in or out lands on the
+// tiles of another level. yLevel is the (power of two) data height of a
+// pixel the tile was refined for. xs are offsets from the tile's start.
+template <typename T>
+struct SampleTile {
+  int xLevel;
+  int yLevel;
+  int64_t index;
+  uint64_t lastUse;
+  vector<T> xs;
+  vector<T> ys;
 };
 
+// The sampled curve of a function in one precision. What's drawn are the
+// visible tiles joined end to end, with x relative to origin, the start
+// of the tile at the center of the view: offsets stay small, so float
+// keeps its resolution wherever the view is.
+template <typename T>
 struct FunctionPlot {
+  double origin;
+  vector<T> xs;
+  vector<T> ys;
+
+  vector<SampleTile<T>> tiles;
+  uint64_t useCounter;
+  int xLevel, yLevel;
+  int64_t firstTile, lastTile;
+  vector<T> gridXs, gridYs;
+};
+
+// A function is sampled in float while float can tell neighbouring samples
+// apart, and in double once the view is zoomed in past that. Zoomed out,
+// the double curve is dropped again.
+struct Function {
   FunctionId id;
   const char* label;
   bool selected;
 
+  // Only for id == Expression; label points at its source.
+  ExprProgram program;
+
+  bool precise;
+  FunctionPlot<float> single;
+  FunctionPlot<double> doubled;
+};
+
+template <typename T>
+void SampleFunction(Function const& function, double start, double step, size_t count, T* xs, T* ys) {
+  switch (function.id) {
+    case Sin: SamplePoints(SampleFunction<Sin, T>, start, step, count, xs, ys); break;
+    case Cos: SamplePoints(SampleFunction<Cos, T>, start, step, count, xs, ys); break;
+    case Sq : SamplePoints(SampleFunction<Sq, T>, start, step, count, xs, ys); break;
+    case Expression:
+      SamplePoints([&](double start, double step, size_t begin, size_t end, T* xs, T* ys) {
+        SampleExpression(function.program, start, step, begin, end, xs, ys);
+      }, start, step, count, xs, ys);
+      break;
+    default: break;
+  }
+}
+
+template <typename T>
+T EvalFunction(Function const& function, T x) {
+  switch (function.id) {
+    case Sin: return EvalFunction<Sin>(x);
+    case Cos: return EvalFunction<Cos>(x);
+    case Sq : return EvalFunction<Sq>(x);
+    case Expression: {
+      T y;
+      EvaluateExpression(function.program, &x, &y, 1);
+      return y;
+    }
+    default: return 0;
+  }
+}
+
+// Adds the points of (x0, x1], splitting the segment in halves while its
+// midpoint is off the chord by more than tolerance, i.e. where the curve
+// bends within the segment. x is an offset from start.
+template <typename T>
+void RefineSegment(Function const& function, double start, T x0, T y0, T x1, T y1, T tolerance, int depth, vector<T>& xs, vector<T>& ys) {
+  if (depth < MAX_REFINE_DEPTH) {
+    T xm = (T)0.5*(x0 + x1);
+    T ym = EvalFunction(function, (T)(start + xm));
+    if (fabs(ym - (T)0.5*(y0 + y1)) > tolerance) {
+      RefineSegment(function, start, x0, y0, xm, ym, tolerance, depth + 1, xs, ys);
+      RefineSegment(function, start, xm, ym, x1, y1, tolerance, depth + 1, xs, ys);
+      return;
+    }
+  }
+  xs.push_back(x1);
+  ys.push_back(y1);
+}
+
+template <typename T>
+SampleTile<T>& GetTile(Function const& function, FunctionPlot<T>& plot, int xLevel, int yLevel, int64_t index) {
+  ++plot.useCounter;
+  for (auto& tile : plot.tiles) {
+    if (tile.xLevel == xLevel && tile.yLevel == yLevel && tile.index == index) {
+      tile.lastUse = plot.useCounter;
+      return tile;
+    }
+  }
+
+  SampleTile<T>* tile = nullptr;
+  if (plot.tiles.size() < TILE_CACHE_SIZE) {
+    tile = &plot.tiles.emplace_back();
+  } else {
+    tile = &*min_element(plot.tiles.begin(), plot.tiles.end(), [](SampleTile<T> const& a, SampleTile<T> const& b) { return a.lastUse < b.lastUse; });
+  }
+  tile->xLevel = xLevel;
+  tile->yLevel = yLevel;
+  tile->index = index;
+  tile->lastUse = plot.useCounter;
+
+  double step = ldexp(1.0, xLevel);
+  double start = (double)index*TILE_SAMPLES*step;
+  plot.gridXs.resize(TILE_SAMPLES + 1);
+  plot.gridYs.resize(TILE_SAMPLES + 1);
+  SampleFunction(function, start, step, TILE_SAMPLES + 1, plot.gridXs.data(), plot.gridYs.data());
+
+  T tolerance = (T)0.5*ldexp((T)1, yLevel);
+  tile->xs.assign(1, plot.gridXs[0]);
+  tile->ys.assign(1, plot.gridYs[0]);
+  for (size_t i = 0; i < TILE_SAMPLES; ++i) {
+    RefineSegment(function, start, plot.gridXs[i], plot.gridYs[i], plot.gridXs[i + 1], plot.gridYs[i + 1], tolerance, 0, tile->xs, tile->ys);
+  }
+  return *tile;
+}
+
+// Brings xs/ys up to date with the visible part of the function. Nothing
+// is resampled unless the view moved onto other tiles or changed level.
+template <typename T>
+void UpdateFunctionPlot(Function const& function, FunctionPlot<T>& plot, ImPlotRect const& view, ImVec2 pixels) {
+  if (function.id == None || pixels.x < 1.0f || pixels.y < 1.0f || view.X.Size() <= 0.0 || view.Y.Size() <= 0.0) return;
+
+  int xLevel = (int)floor(log2(view.X.Size() / pixels.x));
+  int yLevel = (int)floor(log2(view.Y.Size() / pixels.y));
+  double tileWidth = ldexp((double)TILE_SAMPLES, xLevel);
+  int64_t firstTile = (int64_t)floor(view.X.Min / tileWidth);
+  int64_t lastTile = (int64_t)floor(view.X.Max / tileWidth);
+  if (!plot.xs.empty() && xLevel == plot.xLevel && yLevel == plot.yLevel && firstTile == plot.firstTile && lastTile == plot.lastTile) return;
+
+  plot.xLevel = xLevel;
+  plot.yLevel = yLevel;
+  plot.firstTile = firstTile;
+  plot.lastTile = lastTile;
+  int64_t centerTile = firstTile + (lastTile - firstTile) / 2;
+  plot.origin = (double)centerTile*tileWidth;
+  plot.xs.clear();
+  plot.ys.clear();
+  for (int64_t index = firstTile; index <= lastTile; ++index) {
+    SampleTile<T> const& tile = GetTile(function, plot, xLevel, yLevel, index);
+    double offset = (double)(index - centerTile)*tileWidth;
+    // Neighbouring tiles share their boundary sample.
+    size_t skip = plot.xs.empty() ? 0 : 1;
+    for (size_t i = skip; i < tile.xs.size(); ++i) plot.xs.push_back((T)(offset + tile.xs[i]));
+    plot.ys.insert(plot.ys.end(), tile.ys.begin() + skip, tile.ys.end());
+  }
+}
+
+// Float is enough while its rounding error around the view, about |x| *
+// FLT_EPSILON, stays well under the sample spacing.
+bool NeedsDouble(ImPlotRect const& view, ImVec2 pixels) {
+  double magnitude = max(fabs(view.X.Min), fabs(view.X.Max));
+  double spacing = view.X.Size() / max(1.0f, pixels.x);
+  return magnitude*FLT_EPSILON*16.0 > spacing;
+}
+
+void UpdateFunction(Function& function, ImPlotRect const& view, ImVec2 pixels) {
+  function.precise = NeedsDouble(view, pixels);
+  if (function.precise) {
+    UpdateFunctionPlot(function, function.doubled, view, pixels);
+  } else {
+    if (!function.doubled.tiles.empty()) function.doubled = {};
+    UpdateFunctionPlot(function, function.single, view, pixels);
+  }
+}
+
+template <typename T>
+ImPlotPoint FunctionPoint(int i, void* data) {
+  FunctionPlot<T> const& plot = *(FunctionPlot<T> const*)data;
+  return ImPlotPoint(plot.origin + plot.xs[i], plot.ys[i]);
+}
+
+void PlotFunction(Function& function) {
+  if (function.precise) {
+    ImPlot::PlotLineG(function.label, FunctionPoint<double>, &function.doubled, (int)function.doubled.xs.size());
+  } else {
+    ImPlot::PlotLineG(function.label, FunctionPoint<float>, &function.single, (int)function.single.xs.size());
+  }
+}
+
+size_t FunctionSampleCount(Function const& function) {
+  return function.precise ? function.doubled.xs.size() : function.single.xs.size();
+}
+
+constexpr size_t PYRAMID_LEAF = 16;
+constexpr size_t POINTS_PER_COLUMN = 4;
+
+template <typename T>
+struct MinMax {
+  T min, max;
+};
+
+// NaN samples are skipped: min and max keep their first argument when the
+// comparison is false.
+template <typename T>
+MinMax<T> Combine(MinMax<T> a, MinMax<T> b) {
+  return { min(a.min, b.min), max(a.max, b.max) };
+}
+
+template <typename T>
+MinMax<T> Combine(MinMax<T> a, T y) {
+  return { min(a.min, y), max(a.max, y) };
+}
+
+// A sampled series, e.g. telemetry, drawn through M4 decimation: each pixel
+// column shows the first, lowest, highest and last sample that falls in it,
+// which draws the same pixels as the full series. The y range of any run of
+// samples comes from a min/max pyramid whose level k holds one entry per
+// PYRAMID_LEAF << k samples, so a view costs O(pixels log n), whatever the
+// zoom. Decimation needs x sorted; other series are drawn as is.
+//
+// Samples are read in place through a byte stride, from storage or from a
+// mapped file, and are never copied.
+template <typename T>
+struct DataSeries {
+  string label;
+  const T* xs;  // Null when x is the sample number.
+  const T* ys;
+  size_t count;
+  size_t stride;  // In bytes, between consecutive samples.
+  vector<T> storage;
+  shared_ptr<void> mapping;
+  uint64_t version;  // Bumped whenever samples change in place.
+  double origin;     // Added to every x, which may be stored relative to it.
+
+  bool sorted;
+  MinMax<T> xRange;
+  vector<vector<MinMax<T>>> pyramid;
+  size_t pyramidBase;  // Sample i is at position i + pyramidBase of the leaves.
+
+  // The view the decimated points were computed for. When the view holds
+  // few enough samples, they are drawn straight from the series instead.
+  ImPlotRect view;
+  ImVec2 pixels;
+  size_t viewCount;
+  uint64_t viewVersion;
+  bool direct;
+  size_t directBegin, directEnd;
+  vector<T> plotXs;
+  vector<T> plotYs;
+};
+
+template <typename T>
+inline T SeriesX(DataSeries<T> const& series, size_t i) {
+  return series.xs ? *(const T*)((const char*)series.xs + i*series.stride) : (T)i;
+}
+
+template <typename T>
+inline T SeriesY(DataSeries<T> const& series, size_t i) {
+  return *(const T*)((const char*)series.ys + i*series.stride);
+}
+
+// Checks that x is sorted and builds the pyramid. The first level reads
+// every sample, so it is split across threads.
+template <typename T>
+void BuildSeriesPyramid(DataSeries<T>& series) {
+  series.pyramid.clear();
+  series.viewCount = 0;
+  size_t leafCount = (series.count + PYRAMID_LEAF - 1) / PYRAMID_LEAF;
+  vector<MinMax<T>>& leaves = series.pyramid.emplace_back(leafCount);
+
+  size_t sliceCount = max((size_t)1, min(ThreadCount(), leafCount / 4096));
+  vector<char> sliceSorted(sliceCount, 1);
+  vector<MinMax<T>> sliceXRanges(sliceCount, { INFINITY, -INFINITY });
+  ParallelFor(sliceCount, [&](size_t slice) {
+    size_t begin = leafCount*slice/sliceCount;
+    size_t end = leafCount*(slice + 1)/sliceCount;
+    MinMax<T> xRange = { INFINITY, -INFINITY };
+    for (size_t leaf = begin; leaf < end; ++leaf) {
+      size_t first = leaf*PYRAMID_LEAF;
+      size_t last = min(series.count, first + PYRAMID_LEAF);
+      MinMax<T> range = { INFINITY, -INFINITY };
+      for (size_t i = first; i < last; ++i) {
+        range = Combine(range, SeriesY(series, i));
+        T x = SeriesX(series, i);
+        xRange = Combine(xRange, x);
+        // Each leaf also checks its step into the next one.
+        if (i + 1 < series.count && SeriesX(series, i + 1) < x) sliceSorted[slice] = 0;
+      }
+      leaves[leaf] = range;
+    }
+    sliceXRanges[slice] = xRange;
+  });
+  series.sorted = all_of(sliceSorted.begin(), sliceSorted.end(), [](char sorted) { return sorted; });
+  series.xRange = { INFINITY, -INFINITY };
+  for (auto xRange : sliceXRanges) series.xRange = Combine(series.xRange, xRange);
+
+  while (series.pyramid.back().size() > 1) {
+    vector<MinMax<T>> const& below = series.pyramid.back();
+    vector<MinMax<T>> level((below.size() + 1) / 2);
+    for (size_t i = 0; i < level.size(); ++i) {
+      level[i] = 2*i + 1 < below.size() ? Combine(below[2*i], below[2*i + 1]) : below[2*i];
+    }
+    series.pyramid.push_back(std::move(level));
+  }
+}
+
+// Lowest and highest y of samples [begin, end): raw samples up to the first
+// whole leaf and after the last one, and in between the fewest pyramid
+// entries that tile the leaves, climbing a level whenever a pair is whole.
+// Without a pyramid every sample is read.
+template <typename T>
+MinMax<T> SeriesRange(DataSeries<T> const& series, size_t begin, size_t end) {
+  MinMax<T> range = { INFINITY, -INFINITY };
+  size_t base = series.pyramidBase;
+  size_t leafBegin = (begin + base + PYRAMID_LEAF - 1) / PYRAMID_LEAF;
+  size_t leafEnd = (end + base) / PYRAMID_LEAF;
+  if (leafBegin >= leafEnd || series.pyramid.empty()) {
+    leafBegin = leafEnd = 0;
+  } else {
+    for (size_t i = leafEnd*PYRAMID_LEAF - base; i < end; ++i) range = Combine(range, SeriesY(series, i));
+    end = leafBegin*PYRAMID_LEAF - base;
+  }
+  for (size_t i = begin; i < end; ++i) range = Combine(range, SeriesY(series, i));
+
+  for (size_t level = 0; leafBegin < leafEnd; ++level) {
+    if (leafBegin & 1) range = Combine(range, series.pyramid[level][leafBegin++]);
+    if (leafEnd & 1) range = Combine(range, series.pyramid[level][--leafEnd]);
+    leafBegin >>= 1;
+    leafEnd >>= 1;
+  }
+  return range;
+}
+
+// First sample in [begin, end) whose x is at least x.
+template <typename T>
+size_t SeriesLowerBound(DataSeries<T> const& series, size_t begin, size_t end, double x) {
+  while (begin < end) {
+    size_t mid = begin + (end - begin) / 2;
+    if (SeriesX(series, mid) < x) begin = mid + 1;
+    else end = mid;
+  }
+  return begin;
+}
+
+template <typename T>
+void AddPlotPoint(DataSeries<T>& series, T x, T y) {
+  series.plotXs.push_back(x);
+  series.plotYs.push_back(y);
+}
+
+// Brings the drawn points up to date with the view: nothing happens unless
+// the view, the plot size or the samples changed.
+template <typename T>
+void UpdateSeriesView(DataSeries<T>& series, ImPlotRect const& view, ImVec2 pixels) {
+  // Searches happen in the series' own x, relative to its origin.
+  double viewMin = view.X.Min - series.origin;
+  double viewMax = view.X.Max - series.origin;
+  bool same = series.viewCount == series.count && series.viewVersion == series.version && series.pixels.x == pixels.x && series.pixels.y == pixels.y &&
+              series.view.X.Min == view.X.Min && series.view.X.Max == view.X.Max;
+  if (same) return;
+  series.view = view;
+  series.pixels = pixels;
+  series.viewCount = series.count;
+  series.viewVersion = series.version;
+  series.plotXs.clear();
+  series.plotYs.clear();
+
+  // One sample on either side of the view keeps the line running off the
+  // edges.
+  size_t begin = 0, end = series.count;
+  if (series.sorted) {
+    begin = SeriesLowerBound(series, 0, series.count, viewMin);
+    end = SeriesLowerBound(series, begin, series.count, nextafter(viewMax, INFINITY));
+    begin = begin > 0 ? begin - 1 : 0;
+    end = min(series.count, end + 1);
+  }
+  size_t columns = (size_t)max(1.0f, ceil(pixels.x));
+  series.direct = !series.sorted || end - begin <= POINTS_PER_COLUMN*columns;
+  series.directBegin = begin;
+  series.directEnd = end;
+  if (series.direct) return;
+
+  double width = view.X.Size() / (double)columns;
+  size_t first = begin;
+  for (size_t column = 0; column <= columns + 1 && first < end; ++column) {
+    // Columns 0 and columns + 1 hold only the samples outside the view.
+    size_t next = end;
+    if (column == 0) next = first + 1;
+    else if (column <= columns) next = SeriesLowerBound(series, first, end, viewMin + (double)column*width);
+    if (next == first) continue;
+
+    size_t last = next - 1;
+    T firstY = SeriesY(series, first), lastY = SeriesY(series, last);
+    AddPlotPoint(series, SeriesX(series, first), firstY);
+    if (next - first > 2) {
+      MinMax<T> range = SeriesRange(series, first, next);
+      T middle = (T)0.5*(SeriesX(series, first) + SeriesX(series, last));
+      // Whichever extreme is nearer the first sample comes first, so the
+      // column's strokes don't cross.
+      bool minFirst = firstY - range.min < range.max - firstY;
+      AddPlotPoint(series, middle, minFirst ? range.min : range.max);
+      AddPlotPoint(series, middle, minFirst ? range.max : range.min);
+    }
+    if (last != first) AddPlotPoint(series, SeriesX(series, last), lastY);
+    first = next;
+  }
+}
+
+template <typename T>
+ImPlotPoint SeriesPoint(int i, void* data) {
+  DataSeries<T> const& series = *(DataSeries<T> const*)data;
+  if (series.direct) {
+    size_t j = series.directBegin + i;
+    return ImPlotPoint(series.origin + SeriesX(series, j), SeriesY(series, j));
+  }
+  return ImPlotPoint(series.origin + series.plotXs[i], series.plotYs[i]);
+}
+
+template <typename T>
+void PlotSeries(DataSeries<T> const& series) {
+  if (series.origin != 0.0) {
+    int count = series.direct ? (int)(series.directEnd - series.directBegin) : (int)series.plotXs.size();
+    ImPlot::PlotLineG(series.label.c_str(), SeriesPoint<T>, (void*)&series, count);
+  } else if (series.direct) {
+    size_t begin = series.directBegin;
+    int count = (int)(series.directEnd - begin);
+    const T* ys = (const T*)((const char*)series.ys + begin*series.stride);
+    if (series.xs) {
+      const T* xs = (const T*)((const char*)series.xs + begin*series.stride);
+      ImPlot::PlotLine(series.label.c_str(), xs, ys, count, 0, 0, (int)series.stride);
+    } else {
+      ImPlot::PlotLine(series.label.c_str(), ys, count, 1.0, (double)begin, 0, 0, (int)series.stride);
+    }
+  } else {
+    ImPlot::PlotLine(series.label.c_str(), series.plotXs.data(), series.plotYs.data(), (int)series.plotXs.size());
+  }
+}
+
+constexpr size_t STREAM_RING_SIZE = 1 << 20;
+constexpr size_t STREAM_READ_SIZE = 1 << 16;
+constexpr int STREAM_POLL_MS = 50;
+
+// Live samples from a pipe, a Unix socket or a file being appended to, one
+// per line: "y", or "x y" / "x,y". Without an x the sample number is used.
+// The reader thread is the ring's only producer and moves head; the UI
+// thread is its only consumer and moves tail. A full ring drops samples
+// rather than blocking the reader.
+struct StreamSource {
+  string path;
+  unique_ptr<double[]> xs;
+  unique_ptr<float[]> ys;
+  alignas(64) atomic<size_t> head;
+  alignas(64) atomic<size_t> tail;
+  atomic<uint64_t> received;
+  atomic<uint64_t> dropped;
+
+  mutex lock;
+  char status[256];  // guarded by lock
+
+  jthread worker;
+};
+
+// The last `capacity` samples, each written at i and i + capacity so that
+// the window is always one contiguous run that the series can point into.
+// The series' pyramid covers both copies, with capacity a multiple of
+// PYRAMID_LEAF so that new samples only touch their own leaves.
+//
+// x is stored as a float relative to origin, which follows the oldest
+// sample: at a million samples per second the sample number alone outgrows
+// float's 24 bits in 17 seconds.
+struct StreamWindow {
+  size_t capacity;
+  size_t next;
+  size_t filled;
+  double origin;
+  double lastX;
   vector<float> xs;
   vector<float> ys;
+  DataSeries<float> series;
+};
 
-  void computePoints(float start, float end, size_t pointCount) {
-    if (id == None) return;
-
-    xs.clear(pointCount);
-    ys.clear(pointCount);
-    xs.reserve(pointCount);
-    ys.reserve(pointCount);
-
-    float dist = (end - start) / ((float)pointCount - 1.0f);
-    for (size_t i = 0; i < pointCount; ++i) {
-      float x = start + i*dist;
-      xs.push_back(x);
-      switch (id) {
-        case Sin: ys.push_back(sin(x)); break;
-        case Cos: ys.push_back(cos(x)); break;
-        case Sq : ys.push_back(x*x); break;
-        default: break;
+void SetStreamStatus(StreamSource& source, const char* message, const char* detail = nullptr) {
+  lock_guard l(source.lock);
+  if (detail) snprintf(source.status, sizeof(source.status), "%s: %s", message, detail);
+  else snprintf(source.status, sizeof(source.status), "%s", message);
+}
+
+// Sockets are connected to; pipes are opened without blocking on a writer;
+// regular files are followed from their current end, like tail -f.
+int OpenStreamSource(StreamSource& source, bool& isSocket) {
+  struct stat info;
+  if (stat(source.path.c_str(), &info) != 0) {
+    SetStreamStatus(source, "stat failed", strerror(errno));
+    return -1;
+  }
+
+  isSocket = S_ISSOCK(info.st_mode);
+  if (isSocket) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (source.path.size() >= sizeof(address.sun_path)) {
+      SetStreamStatus(source, "socket path too long");
+      return -1;
+    }
+    memcpy(address.sun_path, source.path.c_str(), source.path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+      SetStreamStatus(source, "connect failed", strerror(errno));
+      if (fd >= 0) close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  int fd = open(source.path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    SetStreamStatus(source, "open failed", strerror(errno));
+    return -1;
+  }
+  if (S_ISREG(info.st_mode)) lseek(fd, 0, SEEK_END);
+  return fd;
+}
+
+// Parses the complete lines of [begin, end) into the ring and returns where
+// the unfinished last line starts. The ring's head is published once per
+// call, not per sample.
+const char* ParseStreamLines(StreamSource& source, const char* begin, const char* end, uint64_t& sampleIndex) {
+  size_t head = source.head.load(memory_order_relaxed);
+  size_t tail = source.tail.load(memory_order_acquire);
+  uint64_t received = 0, dropped = 0;
+
+  const char* p = begin;
+  while (true) {
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    if (!eol) break;
+
+    double values[2];
+    size_t valueCount = 0;
+    const char* q = p;
+    while (valueCount < 2) {
+      while (q < eol && (*q == ' ' || *q == '\t' || *q == ',' || *q == ';')) ++q;
+      auto [ptr, ec] = from_chars(q, eol, values[valueCount]);
+      if (ec != errc()) break;
+      q = ptr;
+      ++valueCount;
+    }
+    p = eol + 1;
+    if (valueCount == 0) continue;
+
+    double x = valueCount == 2 ? values[0] : (double)sampleIndex;
+    float y = valueCount == 2 ? values[1] : values[0];
+    ++sampleIndex;
+    if (head - tail == STREAM_RING_SIZE) {
+      tail = source.tail.load(memory_order_acquire);
+      if (head - tail == STREAM_RING_SIZE) {
+        ++dropped;
+        continue;
+      }
+    }
+    source.xs[head & (STREAM_RING_SIZE - 1)] = x;
+    source.ys[head & (STREAM_RING_SIZE - 1)] = y;
+    ++head;
+    ++received;
+  }
+
+  source.head.store(head, memory_order_release);
+  source.received.fetch_add(received, memory_order_relaxed);
+  source.dropped.fetch_add(dropped, memory_order_relaxed);
+  return p;
+}
+
+// Reads with a poll timeout so a stop request is seen within
+// STREAM_POLL_MS. End of file means "nothing yet" for pipes and files, but
+// a closed socket ends the stream.
+void StreamWorker(stop_token stop, StreamSource& source) {
+  bool isSocket = false;
+  int fd = OpenStreamSource(source, isSocket);
+  if (fd < 0) return;
+  SetStreamStatus(source, "reading");
+
+  vector<char> buffer(STREAM_READ_SIZE);
+  size_t pending = 0;
+  uint64_t sampleIndex = 0;
+  while (!stop.stop_requested()) {
+    pollfd request = { fd, POLLIN, 0 };
+    int ready = poll(&request, 1, STREAM_POLL_MS);
+    if (ready < 0 && errno != EINTR) {
+      SetStreamStatus(source, "poll failed", strerror(errno));
+      break;
+    }
+    if (ready <= 0) continue;
+
+    ssize_t n = read(fd, buffer.data() + pending, buffer.size() - pending);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      SetStreamStatus(source, "read failed", strerror(errno));
+      break;
+    }
+    if (n == 0) {
+      if (isSocket) {
+        SetStreamStatus(source, "closed by peer");
+        break;
       }
+      this_thread::sleep_for(chrono::milliseconds(STREAM_POLL_MS / 2));
+      continue;
     }
+
+    const char* end = buffer.data() + pending + n;
+    const char* rest = ParseStreamLines(source, buffer.data(), end, sampleIndex);
+    pending = end - rest;
+    // A line that fills the whole buffer can't be a sample: drop it.
+    if (pending == buffer.size()) pending = 0;
+    memmove(buffer.data(), rest, pending);
   }
+  close(fd);
+}
+
+// Recomputes the window's pyramid leaves over positions [begin, end) of
+// the doubled arrays, then the entries above them.
+void UpdateStreamPyramid(StreamWindow& window, size_t begin, size_t end) {
+  auto& pyramid = window.series.pyramid;
+  size_t leafBegin = begin / PYRAMID_LEAF;
+  size_t leafEnd = (end + PYRAMID_LEAF - 1) / PYRAMID_LEAF;
+  for (size_t leaf = leafBegin; leaf < leafEnd; ++leaf) {
+    MinMax<float> range = { INFINITY, -INFINITY };
+    for (size_t i = leaf*PYRAMID_LEAF; i < (leaf + 1)*PYRAMID_LEAF; ++i) range = Combine(range, window.ys[i]);
+    pyramid[0][leaf] = range;
+  }
+  for (size_t level = 1; level < pyramid.size() && leafBegin < leafEnd; ++level) {
+    leafBegin /= 2;
+    leafEnd = (leafEnd + 1) / 2;
+    auto const& below = pyramid[level - 1];
+    for (size_t i = leafBegin; i < leafEnd; ++i) {
+      pyramid[level][i] = 2*i + 1 < below.size() ? Combine(below[2*i], below[2*i + 1]) : below[2*i];
+    }
+  }
+}
+
+void ResetStreamWindow(StreamWindow& window, size_t capacity) {
+  capacity = (capacity + PYRAMID_LEAF - 1) / PYRAMID_LEAF * PYRAMID_LEAF;
+  window.capacity = capacity;
+  window.next = 0;
+  window.filled = 0;
+  window.origin = NAN;
+  window.lastX = -INFINITY;
+  window.xs.assign(2*capacity, 0.0f);
+  window.ys.assign(2*capacity, 0.0f);
+  window.series.label = "stream";
+  window.series.xs = window.xs.data();
+  window.series.ys = window.ys.data();
+  window.series.count = 0;
+  window.series.stride = sizeof(float);
+  window.series.origin = 0.0;
+  window.series.sorted = true;
+  window.series.pyramidBase = 0;
+  window.series.pyramid.clear();
+  for (size_t leafCount = 2*capacity / PYRAMID_LEAF;; leafCount = (leafCount + 1) / 2) {
+    window.series.pyramid.emplace_back(leafCount);
+    if (leafCount == 1) break;
+  }
+  UpdateStreamPyramid(window, 0, 2*capacity);
+  window.series.version++;
+}
+
+// Moves the origin up to the oldest sample.
+void RebaseStreamWindow(StreamWindow& window) {
+  float shift = window.xs[window.next];
+  for (float& x : window.xs) x -= shift;
+  window.origin += shift;
+}
+
+// Moves everything the reader produced since last frame into the window.
+// Only the newest `capacity` samples can survive, so older ones are skipped.
+// Only the leaves of the slots written are recomputed.
+void DrainStream(StreamSource& source, StreamWindow& window) {
+  size_t tail = source.tail.load(memory_order_relaxed);
+  size_t head = source.head.load(memory_order_acquire);
+  if (head == tail) return;
+  if (head - tail > window.capacity) tail = head - window.capacity;
+
+  size_t capacity = window.capacity;
+  size_t firstSlot = window.next;
+  size_t written = head - tail;
+  if (isnan(window.origin)) window.origin = source.xs[tail & (STREAM_RING_SIZE - 1)];
+  for (; tail != head; ++tail) {
+    double x = source.xs[tail & (STREAM_RING_SIZE - 1)];
+    float y = source.ys[tail & (STREAM_RING_SIZE - 1)];
+    if (x < window.lastX) window.series.sorted = false;
+    window.lastX = x;
+    float relative = (float)(x - window.origin);
+    window.xs[window.next] = window.xs[window.next + capacity] = relative;
+    window.ys[window.next] = window.ys[window.next + capacity] = y;
+    window.next = window.next + 1 == capacity ? 0 : window.next + 1;
+    window.filled = min(window.filled + 1, capacity);
+
+    // Once the oldest sample is more than halfway from the origin to the
+    // newest one, rebase: x then stays within two window spans, which float
+    // resolves exactly for sample numbers up to the largest window.
+    if (window.filled == capacity && window.series.sorted && 2.0f*window.xs[window.next] > relative) {
+      RebaseStreamWindow(window);
+    }
+  }
+  source.tail.store(head, memory_order_release);
+
+  // The slots written appear at their position and a capacity later.
+  UpdateStreamPyramid(window, firstSlot, firstSlot + written);
+  UpdateStreamPyramid(window, firstSlot + capacity, min(2*capacity, firstSlot + capacity + written));
+  if (firstSlot + written > capacity) UpdateStreamPyramid(window, 0, firstSlot + written - capacity);
+
+  size_t start = window.filled < capacity ? 0 : window.next;
+  window.series.xs = window.xs.data() + start;
+  window.series.ys = window.ys.data() + start;
+  window.series.count = window.filled;
+  window.series.origin = window.origin;
+  window.series.pyramidBase = start;
+  window.series.version++;
+}
+
+void StartStream(unique_ptr<StreamSource>& stream, const char* path) {
+  stream = make_unique<StreamSource>();
+  stream->path = path;
+  stream->xs = make_unique<double[]>(STREAM_RING_SIZE);
+  stream->ys = make_unique<float[]>(STREAM_RING_SIZE);
+  snprintf(stream->status, sizeof(stream->status), "opening");
+  stream->worker = jthread(StreamWorker, std::ref(*stream));
+}
+
+enum DataFormat {
+  Format_Csv32,
+  Format_Csv64,
+  Format_Raw32,
+  Format_Raw64,
 };
 
+const char* const DATA_FORMAT_NAMES[] = { "CSV as float", "CSV as double", "Raw float", "Raw double" };
+
+// Where a series comes from: for CSV, which fields; for raw files, the
+// number of values per record and which of them. xColumn < 0 plots against
+// the row number.
+struct DataSource {
+  DataFormat format;
+  int columns;
+  int xColumn;
+  int yColumn;
+};
+
+struct MappedFile {
+  const char* data;
+  size_t size;
+};
+
+bool MapFile(const char* path, MappedFile& file, char* error, size_t errorSize) {
+  file = {};
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    snprintf(error, errorSize, "open %s: %s", path, strerror(errno));
+    return false;
+  }
+
+  struct stat st = {};
+  if (fstat(fd, &st) == -1) {
+    snprintf(error, errorSize, "fstat %s: %s", path, strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  file.size = st.st_size;
+  if (file.size > 0) {
+    void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      snprintf(error, errorSize, "mmap %s: %s", path, strerror(errno));
+      close(fd);
+      return false;
+    }
+    file.data = (const char*)data;
+  }
+
+  close(fd);
+  return true;
+}
+
+shared_ptr<void> MappingOwner(MappedFile file) {
+  return shared_ptr<void>((void*)file.data, [file](void*) {
+    if (file.data) munmap((void*)file.data, file.size);
+  });
+}
+
+string SeriesLabel(const char* path, string_view column) {
+  const char* name = strrchr(path, '/');
+  string label = name ? name + 1 : path;
+  label += ": ";
+  label += column;
+  return label;
+}
+
+// Points the series straight into the mapping; x and y stay interleaved in
+// the file and are read through the record stride. A trailing partial
+// record is ignored.
+template <typename T>
+bool LoadRawSeries(const char* path, DataSource const& source, DataSeries<T>& series, char* status, size_t statusSize) {
+  if constexpr (endian::native != endian::little) {
+    snprintf(status, statusSize, "raw files are little-endian, this machine isn't");
+    return false;
+  }
+  if (source.columns < 1 || source.yColumn < 0 || source.yColumn >= source.columns || source.xColumn >= source.columns) {
+    snprintf(status, statusSize, "columns out of range for %d values per record", source.columns);
+    return false;
+  }
+
+  MappedFile file;
+  if (!MapFile(path, file, status, statusSize)) return false;
+  series = {};
+  series.mapping = MappingOwner(file);
+  series.stride = source.columns*sizeof(T);
+  series.count = file.size / series.stride;
+  series.ys = (const T*)(file.data + source.yColumn*sizeof(T));
+  if (source.xColumn >= 0) series.xs = (const T*)(file.data + source.xColumn*sizeof(T));
+  series.label = SeriesLabel(path, "#" + to_string(source.yColumn));
+  return true;
+}
+
+// Field `column` of the line as a number; NaN when missing or not numeric,
+// which leaves a gap in the plot.
+template <typename T>
+T ParseCsvField(const char* p, const char* end, char separator, int column) {
+  for (int i = 0; i < column; ++i) {
+    p = (const char*)memchr(p, separator, end - p);
+    if (!p) return NAN;
+    ++p;
+  }
+  while (p < end && (*p == ' ' || *p == '"')) ++p;
+  T value;
+  auto [ptr, ec] = from_chars(p, end, value);
+  return ec == errc() ? value : NAN;
+}
+
+// Splits the mapping into one chunk per thread at line starts, counts the
+// lines of every chunk, then parses each chunk straight into its slice of
+// the series storage, with x and y interleaved.
+template <typename T>
+bool LoadCsvSeries(const char* path, DataSource const& source, DataSeries<T>& series, char* status, size_t statusSize) {
+  constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+  if (source.yColumn < 0) {
+    snprintf(status, statusSize, "no y column");
+    return false;
+  }
+  MappedFile file;
+  if (!MapFile(path, file, status, statusSize)) return false;
+  if (file.size == 0) {
+    snprintf(status, statusSize, "%s: no samples", path);
+    return false;
+  }
+  shared_ptr<void> mapping = MappingOwner(file);
+  madvise((void*)file.data, file.size, MADV_SEQUENTIAL);
+
+  const char* begin = file.data;
+  const char* end = file.data + file.size;
+  const char* firstEnd = (const char*)memchr(begin, '\n', end - begin);
+  if (!firstEnd) firstEnd = end;
+  char separator = ',';
+  for (char candidate : { ',', '\t', ';' }) {
+    if (memchr(begin, candidate, firstEnd - begin)) {
+      separator = candidate;
+      break;
+    }
+  }
+
+  // A first line whose y field isn't a number is a header.
+  string yName = "#" + to_string(source.yColumn);
+  if (isnan(ParseCsvField<T>(begin, firstEnd, separator, source.yColumn))) {
+    const char* field = begin;
+    for (int i = 0; field && i < source.yColumn; ++i) {
+      field = (const char*)memchr(field, separator, firstEnd - field);
+      if (field) ++field;
+    }
+    if (field) {
+      const char* fieldEnd = (const char*)memchr(field, separator, firstEnd - field);
+      yName.assign(field, fieldEnd ? fieldEnd : firstEnd);
+      erase(yName, '"');
+      if (!yName.empty() && yName.back() == '\r') yName.pop_back();
+    }
+    begin = firstEnd < end ? firstEnd + 1 : end;
+  }
+
+  size_t size = end - begin;
+  size_t chunkCount = max((size_t)1, min(ThreadCount(), size / MIN_CHUNK_SIZE));
+  vector<const char*> chunkStarts(chunkCount + 1, end);
+  chunkStarts[0] = begin;
+  for (size_t i = 1; i < chunkCount; ++i) {
+    const char* rawStart = max(chunkStarts[i - 1], begin + size*i/chunkCount);
+    const char* eol = (const char*)memchr(rawStart, '\n', end - rawStart);
+    chunkStarts[i] = eol ? eol + 1 : end;
+  }
+
+  vector<size_t> rowStarts(chunkCount + 1, 0);
+  ParallelFor(chunkCount, [&](size_t i) {
+    size_t lines = 0;
+    const char* p = chunkStarts[i];
+    while (const char* eol = (const char*)memchr(p, '\n', chunkStarts[i + 1] - p)) {
+      ++lines;
+      p = eol + 1;
+    }
+    rowStarts[i + 1] = lines + (p < chunkStarts[i + 1]);
+  });
+  for (size_t i = 0; i < chunkCount; ++i) rowStarts[i + 1] += rowStarts[i];
+
+  // x is stored relative to the first row's, so that float series of
+  // epoch times keep their resolution.
+  bool hasX = source.xColumn >= 0;
+  size_t valuesPerRow = hasX ? 2 : 1;
+  series = {};
+  if (hasX) {
+    const char* eol = (const char*)memchr(begin, '\n', end - begin);
+    series.origin = ParseCsvField<double>(begin, eol ? eol : end, separator, source.xColumn);
+    if (!isfinite(series.origin)) series.origin = 0.0;
+  }
+  double origin = series.origin;
+  series.storage.resize(rowStarts[chunkCount]*valuesPerRow);
+  ParallelFor(chunkCount, [&](size_t i) {
+    T* out = series.storage.data() + rowStarts[i]*valuesPerRow;
+    for (const char* p = chunkStarts[i]; p < chunkStarts[i + 1];) {
+      const char* eol = (const char*)memchr(p, '\n', chunkStarts[i + 1] - p);
+      if (!eol) eol = chunkStarts[i + 1];
+      if (hasX) *out++ = (T)(ParseCsvField<double>(p, eol, separator, source.xColumn) - origin);
+      *out++ = ParseCsvField<T>(p, eol, separator, source.yColumn);
+      p = eol + 1;
+    }
+  });
+
+  series.count = rowStarts[chunkCount];
+  series.stride = valuesPerRow*sizeof(T);
+  series.ys = series.storage.data() + (hasX ? 1 : 0);
+  if (hasX) series.xs = series.storage.data();
+  series.label = SeriesLabel(path, yName);
+  return true;
+}
+
+typedef variant<DataSeries<float>, DataSeries<double>> AnySeries;
+
+bool LoadSeries(const char* path, DataSource const& source, vector<AnySeries>& list, ImPlotRect& bounds, char* status, size_t statusSize) {
+  auto startTime = chrono::steady_clock::now();
+
+  AnySeries loaded;
+  bool ok = false;
+  switch (source.format) {
+    case Format_Csv32: ok = LoadCsvSeries(path, source, loaded.emplace<DataSeries<float>>(), status, statusSize); break;
+    case Format_Csv64: ok = LoadCsvSeries(path, source, loaded.emplace<DataSeries<double>>(), status, statusSize); break;
+    case Format_Raw32: ok = LoadRawSeries(path, source, loaded.emplace<DataSeries<float>>(), status, statusSize); break;
+    case Format_Raw64: ok = LoadRawSeries(path, source, loaded.emplace<DataSeries<double>>(), status, statusSize); break;
+  }
+  if (!ok) return false;
+
+  size_t count = visit([](auto& series) { return series.count; }, loaded);
+  if (count == 0) {
+    snprintf(status, statusSize, "%s: no samples", path);
+    return false;
+  }
+
+  // Bounds for fitting the view; all-NaN data has none.
+  visit([&](auto& series) {
+    BuildSeriesPyramid(series);
+    auto yRange = series.pyramid.back()[0];
+    bounds.X = { series.origin + series.xRange.min, series.origin + series.xRange.max };
+    bounds.Y = { (double)yRange.min, (double)yRange.max };
+  }, loaded);
+  for (ImPlotRange* range : { &bounds.X, &bounds.Y }) {
+    if (range->Size() == 0.0) *range = { range->Min - 1.0, range->Max + 1.0 };
+  }
+  list.push_back(std::move(loaded));
+
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+  snprintf(status, statusSize, "Loaded %zu samples in %.3f s", count, seconds);
+  return true;
+}
+
+// Recompiles the expression plot after its text changed. Until the text
+// parses again the last good curve stays up.
+void SetFunctionExpression(Function& function, const char* text, char* error, size_t errorSize) {
+  error[0] = 0;
+  string_view source(text);
+  while (!source.empty() && isspace((unsigned char)source.back())) source.remove_suffix(1);
+  if (source.empty()) {
+    function.id = None;
+    function.label = "##expression";
+    function.program = {};
+  } else if (CompileExpression(source, function.program, error, errorSize)) {
+    function.id = Expression;
+    function.label = function.program.source.c_str();
+  } else {
+    return;
+  }
+  function.single = {};
+  function.doubled = {};
+}
+
 struct App {
   float w, h;
-  array<FunctionPlot, 3> plots;
+  array<Function, 4> functions;
+  char expression[EXPR_MAX_LENGTH + 1];
+  char expressionError[128];
+
+  char dataPath[PATH_MAX];
+  DataSource dataSource;
+  char dataStatus[256];
+  vector<AnySeries> series;
+  bool fitData;
+  ImPlotRect dataBounds;
+
+  char streamPath[PATH_MAX];
+  int streamWindowSize;
+  bool followStream;
+  unique_ptr<StreamSource> stream;
+  StreamWindow streamWindow;
 };
 
 void AppInit(App& app, float w, float h) {
@@ -51,9 +1553,15 @@ void AppInit(App& app, float w, float h) {
     app.w = w;
     app.h = h;
 
-    app.plots[0] = FunctionPlot { Sin, "sin(x)", false };
-    app.plots[1] = FunctionPlot { Cos, "cos(x)", false };
-    app.plots[2] = FunctionPlot { Sq , "sq(x)" , false };
+    app.functions[0] = Function { Sin, "sin(x)", false };
+    app.functions[1] = Function { Cos, "cos(x)", false };
+    app.functions[2] = Function { Sq , "sq(x)" , false };
+    app.functions[3] = Function { None, "##expression", true };
+
+    app.dataSource = { Format_Csv32, 2, 0, 1 };
+
+    app.streamWindowSize = 100000;
+    app.followStream = true;
 }
 
 void AppUpdateAndRender(App& app) {
@@ -62,26 +1570,122 @@ void AppUpdateAndRender(App& app) {
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
     ImGui::Begin("Function Plotter", nullptr, flags);
 
-    constexpr float start = -100.0;
-    constexpr float end = 100.0;
-    constexpr size_t POINT_COUNT = 10000;
+    Function& custom = app.functions[3];
+    for (auto& function : app.functions) {
+      if (&function == &custom) continue;
+      ImGui::Checkbox(function.label, &function.selected);
+      ImGui::SameLine();
+    }
+    ImGui::Checkbox("##custom", &custom.selected);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(300.0f);
+    if (ImGui::InputTextWithHint("##expressionText", "sin(x)*exp(-x*x/50)", app.expression, sizeof(app.expression))) {
+      SetFunctionExpression(custom, app.expression, app.expressionError, sizeof(app.expressionError));
+    }
+    ImGui::SameLine();
+    if (app.expressionError[0]) {
+      ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "%s", app.expressionError);
+    } else {
+      size_t sampleCount = 0;
+      bool precise = false;
+      for (auto& function : app.functions) {
+        if (!function.selected) continue;
+        sampleCount += FunctionSampleCount(function);
+        precise |= function.precise;
+      }
+      ImGui::Text("%zu samples in %s", sampleCount, precise ? "double" : "float");
+    }
 
-    for (auto& plot : app.plots) {
-      if (ImGui::Checkbox(plot.label, &plot.selected)) {
-        if (plot.xs.empty()) {
-          plot.computePoints(start, end, POINT_COUNT);
-        }
+    ImGui::SetNextItemWidth(300.0f);
+    ImGui::InputTextWithHint("##data", "CSV or raw file to load", app.dataPath, sizeof(app.dataPath));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(130.0f);
+    ImGui::Combo("##format", (int*)&app.dataSource.format, DATA_FORMAT_NAMES, IM_ARRAYSIZE(DATA_FORMAT_NAMES));
+    if (app.dataSource.format == Format_Raw32 || app.dataSource.format == Format_Raw64) {
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(90.0f);
+      ImGui::InputInt("Columns", &app.dataSource.columns);
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(90.0f);
+    ImGui::InputInt("X", &app.dataSource.xColumn);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(90.0f);
+    ImGui::InputInt("Y", &app.dataSource.yColumn);
+    ImGui::SameLine();
+    if (ImGui::Button("Load") && app.dataPath[0]) {
+      app.fitData = LoadSeries(app.dataPath, app.dataSource, app.series, app.dataBounds, app.dataStatus, sizeof(app.dataStatus)) &&
+                    isfinite(app.dataBounds.X.Size()) && isfinite(app.dataBounds.Y.Size());
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+      app.series.clear();
+      app.dataStatus[0] = 0;
+    }
+    ImGui::SameLine();
+    ImGui::TextUnformatted(app.dataStatus);
+
+    ImGui::SetNextItemWidth(300.0f);
+    ImGui::InputTextWithHint("##stream", "pipe, Unix socket or file to follow", app.streamPath, sizeof(app.streamPath));
+    ImGui::SameLine();
+    if (ImGui::Button(app.stream ? "Disconnect" : "Connect")) {
+      if (app.stream) {
+        app.stream.reset();
+      } else if (app.streamPath[0]) {
+        ResetStreamWindow(app.streamWindow, app.streamWindowSize);
+        StartStream(app.stream, app.streamPath);
+      }
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(150.0f);
+    if (ImGui::InputInt("Window", &app.streamWindowSize, 10000, 100000)) {
+      app.streamWindowSize = clamp(app.streamWindowSize, 1000, 1 << 23);
+      if (app.stream) ResetStreamWindow(app.streamWindow, app.streamWindowSize);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Follow", &app.followStream);
+    if (app.stream) {
+      DrainStream(*app.stream, app.streamWindow);
+      char status[256];
+      {
+        lock_guard l(app.stream->lock);
+        memcpy(status, app.stream->status, sizeof(status));
       }
+      ImGui::SameLine();
+      ImGui::Text("%s, %llu samples, %llu dropped", status, (unsigned long long)app.stream->received.load(), (unsigned long long)app.stream->dropped.load());
     }
 
+    DataSeries<float>& streamSeries = app.streamWindow.series;
+    double streamFirstX = streamSeries.count > 0 ? streamSeries.origin + SeriesX(streamSeries, 0) : 0.0;
+    bool following = app.followStream && streamSeries.count > 1 && streamFirstX < app.streamWindow.lastX;
     ImPlot::BeginPlot("###plot", ImVec2(-1.0f, -1.0f));
-    for (auto& plot : app.plots) {
-      if (plot.selected) {
-        ImPlot::PlotLine(plot.label, plot.xs.data(), plot.ys.data(), plot.xs.size());
+    ImPlot::SetupAxis(ImAxis_Y1, nullptr, following ? ImPlotAxisFlags_AutoFit : ImPlotAxisFlags_None);
+    ImPlot::SetupAxesLimits(-100.0, 100.0, -2.0, 2.0);
+    if (app.fitData) {
+      ImPlotRect const& bounds = app.dataBounds;
+      ImPlot::SetupAxesLimits(bounds.X.Min, bounds.X.Max, bounds.Y.Min, bounds.Y.Max, ImPlotCond_Always);
+      app.fitData = false;
+    }
+    if (following) ImPlot::SetupAxisLimits(ImAxis_X1, streamFirstX, app.streamWindow.lastX, ImPlotCond_Always);
+    ImPlotRect view = ImPlot::GetPlotLimits();
+    ImVec2 pixels = ImPlot::GetPlotSize();
+    for (auto& function : app.functions) {
+      if (function.selected && function.id != None) {
+        UpdateFunction(function, view, pixels);
+        PlotFunction(function);
       }
     }
+    for (auto& any : app.series) {
+      visit([&](auto& series) {
+        UpdateSeriesView(series, view, pixels);
+        PlotSeries(series);
+      }, any);
+    }
+    if (streamSeries.count > 0) {
+      UpdateSeriesView(streamSeries, view, pixels);
+      PlotSeries(streamSeries);
+    }
     ImPlot::EndPlot();
 
     ImGui::End();
 }
-